@@ -2,38 +2,100 @@
 
 extern void PeryanMain();
 
-void *PRMalloc(unsigned int size);
+void *PRMalloc(unsigned long long size);
 void PRFree(void *ptr);
-void *PRRealloc(void *ptr, int size);
+void *PRRealloc(void *ptr, unsigned long long size);
 
 int stat = 0;
 
 /* Begin implementation of built-in String */
 
+/*
+ * String is reference counted and shared by its copies (the code generator increments refCount).
+ * Functions which modify the String in place have to PRStringDetach() it before that.
+ *
+ * Short strings are stored in small[] so that they need only one allocation.
+ * str points to small[] or to the allocated buffer.
+ *
+ * String literals are static and immortal: their refCount starts from PR_STRING_IMMORTAL
+ * so that it never reaches zero (and they are always copied before modified).
+ * The code generator assumes this layout and these values (layout.h is shared with it).
+ */
+#include "layout.h"
+
 struct String {
+	int refCount; /* the code generator assumes it is the first member */
 	int length;
 	int capacity;
 	char *str;
+	char small[PR_STRING_SMALL_CAPACITY];
 };
 
-struct String *PRStringConstructorCStr(char *cStr)
+/* allocate String which can contain length characters (and terminating null character) */
+struct String *PRStringAllocate(int length)
 {
-	int i = 0;
 	struct String *res = NULL;
-	DBG_PRINT(+, PRStringConstructorCStr);
+	DBG_PRINT(+, PRStringAllocate);
 
 	res = PRMalloc(sizeof(struct String));
 	if (res == NULL)
 		AbortWithErrorMessage("runtime error: failed to allocate memory");
 
-	for (res->length = 0; cStr[res->length] != 0; )
-		res->length++;
+	res->refCount = 1;
+	res->length = length;
 
-	res->capacity = res->length + 1;
+	if (length + 1 <= PR_STRING_SMALL_CAPACITY) {
+		res->capacity = PR_STRING_SMALL_CAPACITY;
+		res->str = res->small;
+	} else {
+		res->capacity = length + 1;
+		res->str = PRMalloc(res->capacity);
+		if (res->str == NULL)
+			AbortWithErrorMessage("runtime error: failed to allocate memory");
+	}
 
-	res->str = PRMalloc(res->capacity);
-	if (res->str == NULL)
+	DBG_PRINT(-, PRStringAllocate);
+	return res;
+}
+
+/* extend the capacity to contain length characters (and terminating null character) */
+void PRStringReserve(struct String *str, int length)
+{
+	char *prev = str->str;
+	int i = 0;
+
+	if (length < str->capacity)
+		return;
+
+	while (!(length < str->capacity)) {
+		str->capacity *= 2;
+	}
+
+	if (prev == str->small) {
+		str->str = PRMalloc(str->capacity);
+		if (str->str != NULL) {
+			for (i = 0; i <= str->length; ++i)
+				str->str[i] = prev[i];
+		}
+	} else {
+		str->str = PRRealloc(prev, str->capacity);
+	}
+
+	if (str->str == NULL)
 		AbortWithErrorMessage("runtime error: failed to allocate memory");
+	return;
+}
+
+struct String *PRStringConstructorCStr(char *cStr)
+{
+	int i = 0, length = 0;
+	struct String *res = NULL;
+	DBG_PRINT(+, PRStringConstructorCStr);
+
+	for (length = 0; cStr[length] != 0; )
+		length++;
+
+	res = PRStringAllocate(length);
 
 	for (i = 0; (res->str[i] = cStr[i]) != 0; ++i)
 		;
@@ -48,24 +110,26 @@ struct String *PRStringConstructorVoid()
 	return PRStringConstructorCStr("");
 }
 
-struct String *PRStringConstructorInt(int num)
+struct String *PRStringConstructorInt64(long long num)
 {
-	char str[20], tmp = 0;
+	char str[24], tmp = 0;
 	int len = 0, isNeg = 0, i = 0, j = 0;
+	unsigned long long abs = num;
 
-	DBG_PRINT(+, PRStringConstructorInt);
+	DBG_PRINT(+, PRStringConstructorInt64);
 
+	/* the absolute value is unsigned so that the minimum value does not overflow */
 	if (num < 0) {
 		isNeg = 1;
-		num = -num;
+		abs = 0ull - abs;
 	}
 
-	if (num == 0) {
+	if (abs == 0) {
 		str[len++] = '0';
 	} else {
-		while (num > 0) {
-			str[len++] = (char)(num % 10) + '0';
-			num /= 10;
+		while (abs > 0) {
+			str[len++] = (char)(abs % 10) + '0';
+			abs /= 10;
 		}
 	}
 
@@ -79,26 +143,23 @@ struct String *PRStringConstructorInt(int num)
 
 	str[len] = 0;
 
-	DBG_PRINT(-, PRStringConstructorInt);
+	DBG_PRINT(-, PRStringConstructorInt64);
 	return PRStringConstructorCStr((char *)str);
 }
 
+struct String *PRStringConstructorInt(int num)
+{
+	DBG_PRINT(+-, PRStringConstructorInt);
+	return PRStringConstructorInt64(num);
+}
+
 struct String *PRStringConcatenate(struct String *lhs, struct String *rhs)
 {
 	int i = 0;
 	struct String *res = NULL;
 	DBG_PRINT(+, PRStringConcatenate);
 
-	res = PRMalloc(sizeof(struct String));
-	if (res == NULL)
-		AbortWithErrorMessage("runtime error: failed to allocate memory");
-
-	res->length = lhs->length + rhs->length;
-	res->capacity = res->length + 1;
-
-	res->str = PRMalloc(res->capacity);
-	if (res->str == NULL)
-		AbortWithErrorMessage("runtime error: failed to allocate memory");
+	res = PRStringAllocate(lhs->length + rhs->length);
 
 	for (i = 0; (res->str[i] = lhs->str[i]) != 0; ++i)
 		;
@@ -109,20 +170,75 @@ struct String *PRStringConcatenate(struct String *lhs, struct String *rhs)
 	return res;
 }
 
-void PRStringAppendCStr(struct String *lhs, const char *rhs) {
+/* concatenate all of the count Strings in strs (chains of + are fused into it) */
+struct String *PRStringConcatenateN(int count, struct String **strs)
+{
+	int i = 0, j = 0, length = 0;
+	struct String *res = NULL;
+	DBG_PRINT(+, PRStringConcatenateN);
+
+	for (i = 0; i < count; ++i)
+		length += strs[i]->length;
+
+	res = PRStringAllocate(length);
+
+	length = 0;
+	for (i = 0; i < count; ++i) {
+		for (j = 0; j < strs[i]->length; ++j)
+			res->str[length + j] = strs[i]->str[j];
+		length += strs[i]->length;
+	}
+	res->str[length] = 0;
+
+	DBG_PRINT(-, PRStringConcatenateN);
+	return res;
+}
+
+struct String *PRStringClone(struct String *str)
+{
+	int i = 0;
+	struct String *res = NULL;
+	DBG_PRINT(+, PRStringClone);
+
+	res = PRStringAllocate(str->length);
+
+	for (i = 0; i < str->length; ++i)
+		res->str[i] = str->str[i];
+	res->str[res->length] = 0;
+
+	DBG_PRINT(-, PRStringClone);
+	return res;
+}
+
+/* make *str owned only by the caller (copy on write) */
+void PRStringDetach(struct String **str)
+{
+	struct String *shared = *str;
+
+	if (shared->refCount == 1)
+		return;
+
+	DBG_PRINT(+, PRStringDetach);
+	*str = PRStringClone(shared);
+	shared->refCount--;
+	DBG_PRINT(-, PRStringDetach);
+	return;
+}
+
+void PRStringAppendCStr(struct String **lhsRef, const char *rhs) {
+	struct String *lhs = NULL;
 	int rhsLength = 0;
 	int i = 0;
 
 	DBG_PRINT(+, PRStringAppendCStr);
 
+	PRStringDetach(lhsRef);
+	lhs = *lhsRef;
+
 	for (rhsLength = 0; rhs[rhsLength] != 0; )
 		rhsLength++;
 
-	while(!(lhs->length + rhsLength < lhs->capacity)) {
-		lhs->capacity *= 2;
-	}
-
-	lhs->str = PRRealloc(lhs->str, lhs->capacity);
+	PRStringReserve(lhs, lhs->length + rhsLength);
 
 	for (i = 0; i < rhsLength; ++i) {
 		lhs->str[lhs->length + i] = rhs[i];
@@ -136,17 +252,17 @@ void PRStringAppendCStr(struct String *lhs, const char *rhs) {
 	return;
 }
 
-void PRStringAppend(struct String *lhs, struct String *rhs)
+void PRStringAppend(struct String **lhsRef, struct String *rhs)
 {
+	struct String *lhs = NULL;
 	int i = 0;
 	DBG_PRINT(+, PRStringAppend);
 
-	while (!(lhs->length + rhs->length < lhs->capacity)) {
-		lhs->capacity *= 2;
-	}
+	PRStringDetach(lhsRef);
+	lhs = *lhsRef;
+
+	PRStringReserve(lhs, lhs->length + rhs->length);
 
-	lhs->str = PRRealloc(lhs->str, lhs->capacity);
-	
 	for (i = 0; i < rhs->length; ++i) {
 		lhs->str[lhs->length + i] = rhs->str[i];
 	}
@@ -161,9 +277,17 @@ void PRStringAppend(struct String *lhs, struct String *rhs)
 
 void PRStringDestructor(struct String *str)
 {
+	/* variables are nulled after they are destructed */
+	if (str == NULL)
+		return;
+
 	DBG_PRINT(+, PRStringDestructor);
-	PRFree(str->str);
-	PRFree(str);
+	str->refCount--;
+	if (str->refCount == 0) {
+		if (str->str != str->small)
+			PRFree(str->str);
+		PRFree(str);
+	}
 	DBG_PRINT(-, PRStringDestructor);
 }
 
@@ -189,6 +313,146 @@ int PRStringLength(struct String *str)
 
 /* End implementation of built-in String */
 
+/* Begin implementation of built-in array */
+
+/*
+ * [T] is laid out as struct Array, and elements points to T[capacity] (the code generator assumes it).
+ * elementSize is sizeof(T). The code generator constructs and destructs the elements,
+ * so these functions only move their bytes.
+ */
+struct Array {
+	long long length;
+	long long capacity;
+	int elementSize;
+	char *elements;
+};
+
+/* move size bytes from src to dest (they may overlap) */
+void PRArrayMove(char *dest, char *src, long long size)
+{
+	long long i = 0;
+
+	if (dest < src) {
+		for (i = 0; i < size; ++i)
+			dest[i] = src[i];
+	} else if (src < dest) {
+		for (i = size - 1; i >= 0; --i)
+			dest[i] = src[i];
+	}
+
+	return;
+}
+
+/* extend the capacity to contain capacity elements exactly */
+void PRArrayReserve(struct Array *array, long long capacity)
+{
+	if (capacity <= array->capacity)
+		return;
+
+	if (array->elements == NULL)
+		array->elements = PRMalloc(capacity * array->elementSize);
+	else
+		array->elements = PRRealloc(array->elements, capacity * array->elementSize);
+
+	if (array->elements == NULL)
+		AbortWithErrorMessage("runtime error: failed to allocate memory");
+
+	array->capacity = capacity;
+	return;
+}
+
+/* extend the capacity to contain length elements (at least doubles it to amortize the cost) */
+void PRArrayGrow(struct Array *array, long long length)
+{
+	if (length <= array->capacity)
+		return;
+
+	if (length < array->capacity * 2)
+		length = array->capacity * 2;
+
+	PRArrayReserve(array, length);
+	return;
+}
+
+/* change the length and return the previous one (the caller constructs or destructs the difference) */
+long long PRArrayResize(struct Array *array, long long length)
+{
+	long long prev = array->length;
+
+	if (length < 0)
+		AbortWithErrorMessage("runtime error: negative array length");
+
+	PRArrayGrow(array, length);
+	array->length = length;
+
+	return prev;
+}
+
+/* called by the range checks generated with --bounds-check */
+void PRArrayIndexOutOfRange()
+{
+	AbortWithErrorMessage("runtime error: array index out of range");
+}
+
+/* return the pointer to the element at index, with its range checked */
+void *PRArrayElement(struct Array *array, long long index)
+{
+	if (index < 0 || array->length <= index)
+		PRArrayIndexOutOfRange();
+
+	return array->elements + index * array->elementSize;
+}
+
+/* append an uninitialized element and return the pointer to it */
+void *PRArrayPush(struct Array *array)
+{
+	PRArrayGrow(array, array->length + 1);
+	array->length++;
+
+	return array->elements + (array->length - 1) * array->elementSize;
+}
+
+/* remove the last element and return the pointer to it (valid until the array is modified) */
+void *PRArrayPop(struct Array *array)
+{
+	if (array->length <= 0)
+		AbortWithErrorMessage("runtime error: pop from empty array");
+
+	array->length--;
+
+	return array->elements + array->length * array->elementSize;
+}
+
+/* insert an uninitialized element before index and return the pointer to it */
+void *PRArrayInsert(struct Array *array, long long index)
+{
+	char *res = NULL;
+
+	if (index < 0 || array->length < index)
+		PRArrayIndexOutOfRange();
+
+	PRArrayGrow(array, array->length + 1);
+
+	res = array->elements + index * array->elementSize;
+	PRArrayMove(res + array->elementSize, res, (array->length - index) * array->elementSize);
+	array->length++;
+
+	return res;
+}
+
+/* remove the element at index (the caller has destructed it through PRArrayElement) */
+void PRArrayRemove(struct Array *array, long long index)
+{
+	char *removed = PRArrayElement(array, index);
+
+	PRArrayMove(removed, removed + array->elementSize, (array->length - index - 1) * array->elementSize);
+	array->length--;
+
+	return;
+}
+
+/* End implementation of built-in array */
+
 int PRIntConstructor(struct String *str)
 {
 	int res = 0, isNeg = 0, i = 0;
@@ -223,16 +487,8 @@ struct String *strmid(struct String *str, int start, int length)
 	int i = 0;
 	struct String *res = NULL;
 
-	res = PRMalloc(sizeof(struct String));
-	if (res == NULL)
-		AbortWithErrorMessage("runtime error: failed to allocate memory");
-
-	res->length = length;
-	res->capacity = res->length + 1;
+	res = PRStringAllocate(length);
 
-	res->str = PRMalloc(res->capacity);
-	if (res->str == NULL)
-		AbortWithErrorMessage("runtime error: failed to allocate memory");
 	for (i = 0; i < length; ++i) {
 		res->str[i] = str->str[start + i];
 	}
@@ -343,13 +599,14 @@ void noteget(struct String** res, int idx)
 	if (end == -1)
 		end = (*noteTarget_)->length;
 
+	tmp.refCount = 1;
 	tmp.length = end - begin;
 	tmp.capacity = 0;
 	tmp.str = (*noteTarget_)->str + begin;
 
 	PRStringDestructor(*res);
 	*res = PRStringConstructorVoid();
-	PRStringAppend(*res, &tmp);
+	PRStringAppend(res, &tmp);
 
 	DBG_PRINT(-, noteget);
 	return;
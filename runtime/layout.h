@@ -0,0 +1,21 @@
+/* the layout of the runtime values, shared by the runtime (common.h) and the code generator (src/LLVMCodeGen.cc) */
+/* it is included from C and C++, so it defines only macros */
+
+#ifndef PERYAN_RUNTIME_LAYOUT_H
+#define PERYAN_RUNTIME_LAYOUT_H
+
+/*
+ * struct String {
+ *	int refCount;
+ *	int length;
+ *	int capacity;
+ *	char *str;
+ *	char small[PR_STRING_SMALL_CAPACITY];
+ * };
+ */
+#define PR_STRING_SMALL_CAPACITY 16
+
+/* the initial refCount of String literals, which never reaches zero */
+#define PR_STRING_IMMORTAL 0x40000000
+
+#endif
@@ -13,7 +13,7 @@ void AbortWithErrorMessage(const char *format, ...);
 #include <stdarg.h>
 #include <stdio.h>
 
-void *PRMalloc(unsigned int size)
+void *PRMalloc(unsigned long long size)
 {
 	DBG_PRINT(+-, PRMalloc);
 	return malloc(size);
@@ -27,7 +27,7 @@ void PRFree(void *ptr)
 	return;
 }
 
-void *PRRealloc(void *ptr, int size)
+void *PRRealloc(void *ptr, unsigned long long size)
 {
 	DBG_PRINT(+-, PRRealloc);
 	return realloc(ptr, size);
@@ -53,6 +53,123 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+/* Profile of the branches (--profile-generate) */
+#define PR_PROFILE_FILE "peryan.prof"
+
+long long *profileCounters_ = NULL;
+int profileCounterNum_ = 0;
+
+/* the counts are added to the profile of the previous runs of the same program */
+void PRProfileWrite()
+{
+	FILE *fp;
+	int i, num;
+	long long count;
+
+	fp = fopen(PR_PROFILE_FILE, "r");
+	if (fp != NULL) {
+		if (fscanf(fp, "%d", &num) == 1 && num == profileCounterNum_) {
+			for (i = 0; i < num && fscanf(fp, "%lld", &count) == 1; ++i)
+				profileCounters_[i] += count;
+		}
+		fclose(fp);
+	}
+
+	fp = fopen(PR_PROFILE_FILE, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot write the profile %s\n", PR_PROFILE_FILE);
+		return;
+	}
+
+	fprintf(fp, "%d\n", profileCounterNum_);
+	for (i = 0; i < profileCounterNum_; ++i)
+		fprintf(fp, "%lld\n", profileCounters_[i]);
+	fclose(fp);
+
+	return;
+}
+
+void PRProfileRegister(long long *counters, int num)
+{
+	DBG_PRINT(+-, PRProfileRegister);
+	profileCounters_ = counters;
+	profileCounterNum_ = num;
+	atexit(PRProfileWrite);
+	return;
+}
+
+/* --instrument */
+/* each record is {calls, cycles, depth}; see LLVMCodeGen.cc */
+long long *instrumentRecords_ = NULL;
+char **instrumentNames_ = NULL;
+int instrumentNum_ = 0;
+
+/* same as llvm.readcyclecounter */
+static long long PRReadCycleCounter()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	unsigned int lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((long long)hi << 32) | lo;
+#else
+	return 0;
+#endif
+}
+
+static int PRInstrumentCompare(const void *lhs, const void *rhs)
+{
+	long long lcycles = instrumentRecords_[*(const int *)lhs * 3 + 1];
+	long long rcycles = instrumentRecords_[*(const int *)rhs * 3 + 1];
+
+	if (lcycles != rcycles)
+		return lcycles < rcycles ? 1 : -1;
+	return *(const int *)lhs - *(const int *)rhs;
+}
+
+void PRInstrumentWrite()
+{
+	long long now = PRReadCycleCounter();
+	long long *record = NULL;
+	int *order = NULL;
+	int i;
+
+	order = (int *)malloc(sizeof(int) * instrumentNum_);
+	assert(order != NULL);
+
+	for (i = 0; i < instrumentNum_; ++i) {
+		/* the functions which are not returned yet (e.g. the program called end) */
+		record = &instrumentRecords_[i * 3];
+		if (record[2] > 0)
+			record[1] += now;
+		record[2] = 0;
+		order[i] = i;
+	}
+
+	qsort(order, instrumentNum_, sizeof(int), PRInstrumentCompare);
+
+	fprintf(stderr, "%-24s %12s %16s %12s\n", "function", "calls", "cycles", "cycles/call");
+	for (i = 0; i < instrumentNum_; ++i) {
+		record = &instrumentRecords_[order[i] * 3];
+		if (record[0] == 0)
+			continue;
+		fprintf(stderr, "%-24s %12lld %16lld %12lld\n",
+				instrumentNames_[order[i]], record[0], record[1], record[1] / record[0]);
+	}
+
+	free(order);
+	return;
+}
+
+void PRInstrumentRegister(long long *records, char **names, int num)
+{
+	DBG_PRINT(+-, PRInstrumentRegister);
+	instrumentRecords_ = records;
+	instrumentNames_ = names;
+	instrumentNum_ = num;
+	atexit(PRInstrumentWrite);
+	return;
+}
+
 /* In case of debugging */
  void printNum(int num) {
 	DBG_PRINT(+, printNum);
@@ -110,8 +227,8 @@ void dirlist(struct String **res, struct String *mask, int mode)
 	DBG_PRINT(+, dirlist);
 
 	cmd = PRStringConstructorCStr("find ");
-	PRStringAppend(cmd, mask);
-	PRStringAppendCStr(cmd, " -maxdepth 0");
+	PRStringAppend(&cmd, mask);
+	PRStringAppendCStr(&cmd, " -maxdepth 0");
 
 	fp = popen(cmd->str, "r");
 
@@ -129,7 +246,7 @@ void dirlist(struct String **res, struct String *mask, int mode)
 		if (fgets(tmp, sizeof(tmp) / sizeof(tmp[0]), fp) == NULL)
 			break;
 
-		PRStringAppendCStr(*res, tmp);
+		PRStringAppendCStr(res, tmp);
 	}
 
 	pclose(fp);
@@ -161,7 +278,7 @@ void noteload(struct String *fileName)
 		if (fgets(tmp, sizeof(tmp) / sizeof(tmp[0]), fp) == NULL)
 			break;
 
-		PRStringAppendCStr(*noteTarget_, tmp);
+		PRStringAppendCStr(noteTarget_, tmp);
 	}
 
 	fclose(fp);
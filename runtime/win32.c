@@ -12,7 +12,7 @@ void AbortWithErrorMessage(const char *message);
 
 #include "common.h"
 
-void *PRMalloc(unsigned int size)
+void *PRMalloc(unsigned long long size)
 {
 	HANDLE hHeap = NULL;
 	LPVOID res = NULL;
@@ -47,7 +47,7 @@ void PRFree(void *ptr)
 	return;
 }
 
-void *PRRealloc(void *ptr, int size)
+void *PRRealloc(void *ptr, unsigned long long size)
 {
 	HANDLE hHeap = NULL;
 	LPVOID res = NULL;
@@ -265,7 +265,7 @@ public:
 	virtual void accept(ASTVisitor *visitor) { return visitor->visit(this); }
 	
 	Expr *refered;
-	RefExpr(Expr *refered) : AST(token), Expr(refered->token), refered(refered) {}
+	RefExpr(Expr *refered) : AST(refered->token), Expr(refered->token), refered(refered) {}
 };
 
 class DerefExpr : public Expr {
@@ -274,7 +274,7 @@ public:
 	virtual void accept(ASTVisitor *visitor) { return visitor->visit(this); }
 	
 	Expr *derefered;
-	DerefExpr(Expr *derefered) : AST(token), Expr(derefered->token), derefered(derefered) {}
+	DerefExpr(Expr *derefered) : AST(derefered->token), Expr(derefered->token), derefered(derefered) {}
 };
 
 class SubscrExpr : public Expr {
@@ -286,7 +286,18 @@ public:
 	Expr *subscript;
 
 	SubscrExpr(Expr *array, const Token& token, Expr *subscript)
-		: AST(token), Expr(token), array(array), subscript(subscript) {}
+		: AST(token), Expr(token), array(array), subscript(subscript)
+		, rangeCheck(UNCHECKED), rangeLoop(NULL) {}
+
+	// decided by BoundsChecker (all subscripts are unchecked without --bounds-check)
+	typedef enum {
+		UNCHECKED,	// not checked or proven to be in range
+		CHECKED,	// checked on each access
+		LOOP_CHECKED	// checked once before rangeLoop (and on each access only if it failed)
+	} RangeCheck;
+
+	RangeCheck rangeCheck;
+	RepeatStmt *rangeLoop;
 };
 
 class MemberExpr : public Expr {
@@ -343,10 +354,13 @@ public:
 	TypeSpec *retTypeSpec;
 	CompStmt *body;
 	FuncDefStmt(const Token& token, Identifier *name, CompStmt *body)
-		: AST(token), Stmt(token), name(name), body(body), symbol(NULL) {}
+		: AST(token), Stmt(token), name(name), body(body), isLibrary(false), symbol(NULL) {}
 
 	std::vector<Expr *> defaults;
 
+	// defined outside of the main source (i.e. in the prelude or included files)
+	bool isLibrary;
+
 	FuncSymbol *symbol;
 };
 
@@ -394,9 +408,18 @@ public:
 	Expr *count;
 	std::vector<Stmt *> stmts;
 	RepeatStmt(const Token& token, Expr *count)
-		: AST(token), Stmt(token), count(count), scope(NULL) {}
+		: AST(token), Stmt(token), count(count), scope(NULL), isCounterModified(true), hasGosub(true) {}
 
 	LocalScope *scope;
+
+	// the body assigns or refers to cnt (cleared by ConstantFolder if not)
+	bool isCounterModified;
+
+	// the body contains gosub, which returns into the body from the outside (cleared by EscapeAnalyzer if not)
+	bool hasGosub;
+
+	// arrays whose range is checked once before the loop (set by BoundsChecker)
+	std::vector<Identifier *> rangeCheckedArrays;
 };
 
 class Label : public Expr {
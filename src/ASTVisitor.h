@@ -43,6 +43,8 @@ class NamespaceStmt;
 
 class ASTVisitor {
 public:
+	virtual ~ASTVisitor() {}
+
 	// Neither statement nor expression
 	virtual void visit(TransUnit *tu) = 0;
 	virtual void visit(Label *label) = 0;
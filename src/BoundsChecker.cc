@@ -0,0 +1,376 @@
+// BoundsChecker decides how each array subscript is range checked with --bounds-check.
+// Every subscript is checked on each access, except the subscripts whose index is the counter
+// of an enclosing repeat loop and whose array is defined outside of the loop:
+// - if the loop repeats array.length times, the subscript is always in range and is not checked
+// - otherwise the range of the counter is checked against the array once before the loop,
+//   and the subscript is checked on each access only if that check failed
+//   (so that the error is still reported at the same iteration)
+// These hold only if the loop body changes neither the length of any array nor the counter,
+// so calling functions, resizing arrays, assigning whole arrays or the counter,
+// and passing them by reference disable them for all the enclosing loops.
+
+#include <cassert>
+
+#include "AST.h"
+#include "SymbolTable.h"
+#include "BoundsChecker.h"
+#include "Options.h"
+#include "WarningPrinter.h"
+
+namespace Peryan {
+
+static bool isArray(Type *type) {
+	return type != NULL && type->unmodify()->getTypeType() == Type::ARRAY_TYPE;
+}
+
+static bool isLength(MemberExpr *me) {
+	return isArray(me->receiver->type)
+		&& (me->member->getString() == "length" || me->member->getString() == "longLength");
+}
+
+void BoundsChecker::visit(TransUnit *tu) {
+	for (std::vector<Stmt *>::iterator it = tu->stmts.begin(); it != tu->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void BoundsChecker::invalidateLoops() {
+	for (std::vector<Loop>::iterator it = loops_.begin(); it != loops_.end(); ++it) {
+		it->invariant = false;
+	}
+
+	return;
+}
+
+// expr may be modified (assigned or referenced)
+void BoundsChecker::markModified(Expr *expr) {
+	if (isArray(expr->type)) {
+		invalidateLoops();
+		return;
+	}
+
+	if (expr->getASTType() != AST::IDENTIFIER)
+		return;
+
+	Symbol *symbol = static_cast<Identifier *>(expr)->symbol;
+	for (std::vector<Loop>::iterator it = loops_.begin(); it != loops_.end(); ++it) {
+		if (it->counter == symbol)
+			it->invariant = false;
+	}
+
+	return;
+}
+
+// visit the subexpressions of expr (which is used as an lvalue)
+void BoundsChecker::visitLvalue(Expr *expr) {
+	if (expr->getASTType() != AST::IDENTIFIER && expr->getASTType() != AST::STATIC_MEMBER_EXPR)
+		expr->accept(this);
+
+	return;
+}
+
+// find the loop if subscript is its counter
+BoundsChecker::Loop *BoundsChecker::findLoopOf(Expr *subscript) {
+	if (subscript->getASTType() != AST::DEREF_EXPR)
+		return NULL;
+
+	Expr *derefered = static_cast<DerefExpr *>(subscript)->derefered;
+	if (derefered->getASTType() != AST::IDENTIFIER)
+		return NULL;
+
+	Symbol *symbol = static_cast<Identifier *>(derefered)->symbol;
+	for (std::vector<Loop>::iterator it = loops_.begin(); it != loops_.end(); ++it) {
+		if (it->counter == symbol)
+			return &(*it);
+	}
+
+	return NULL;
+}
+
+void BoundsChecker::visit(FuncDefStmt *fds) {
+	assert(fds != NULL);
+
+	// the body wasn't resolved since nothing refers to the function
+	if (fds->symbol->isUnused)
+		return;
+
+	std::vector<Loop> outerLoops;
+	outerLoops.swap(loops_);
+
+	fds->body->accept(this);
+
+	loops_.swap(outerLoops);
+	return;
+}
+
+void BoundsChecker::visit(VarDefStmt *vds) {
+	assert(vds != NULL);
+
+	for (std::vector<Loop>::iterator it = loops_.begin(); it != loops_.end(); ++it) {
+		it->defined.insert(vds->symbol);
+	}
+
+	if (vds->init != NULL)
+		vds->init->accept(this);
+
+	return;
+}
+
+void BoundsChecker::visit(AssignStmt *as) {
+	assert(as != NULL);
+
+	markModified(as->lhs);
+	visitLvalue(as->lhs);
+
+	if (as->rhs != NULL)
+		as->rhs->accept(this);
+
+	return;
+}
+
+void BoundsChecker::visit(CompStmt *cs) {
+	assert(cs != NULL);
+
+	for (std::vector<Stmt *>::iterator it = cs->stmts.begin(); it != cs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void BoundsChecker::visit(IfStmt *is) {
+	assert(is != NULL);
+
+	for (std::vector<Expr *>::iterator it = is->ifCond.begin(); it != is->ifCond.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	for (std::vector<CompStmt *>::iterator it = is->ifThen.begin(); it != is->ifThen.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	if (is->elseThen != NULL)
+		is->elseThen->accept(this);
+
+	return;
+}
+
+void BoundsChecker::visit(RepeatStmt *rs) {
+	assert(rs != NULL);
+
+	// the count is evaluated once before the loop
+	if (rs->count != NULL)
+		rs->count->accept(this);
+
+	{
+		Loop loop;
+		loop.stmt = rs;
+		loop.counter = rs->scope->resolve("cnt", rs->token.getPosition());
+		loop.lengthOf = NULL;
+		loop.invariant = (rs->count != NULL);
+
+		// repeat array.length (or array.longLength)
+		if (rs->count != NULL && rs->count->getASTType() == AST::MEMBER_EXPR) {
+			MemberExpr *me = static_cast<MemberExpr *>(rs->count);
+			if (isLength(me) && me->receiver->getASTType() == AST::IDENTIFIER)
+				loop.lengthOf = static_cast<Identifier *>(me->receiver)->symbol;
+		}
+
+		loops_.push_back(loop);
+	}
+
+	for (std::vector<Stmt *>::iterator it = rs->stmts.begin(); it != rs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	Loop& loop = loops_.back();
+	assert(loop.stmt == rs);
+
+	if (loop.invariant) {
+		for (std::vector<SubscrExpr *>::iterator it = loop.subscripts.begin();
+				it != loop.subscripts.end(); ++it) {
+			Identifier *array = static_cast<Identifier *>((*it)->array);
+
+			if (array->symbol == loop.lengthOf) {
+				(*it)->rangeCheck = SubscrExpr::UNCHECKED;
+				continue;
+			}
+
+			(*it)->rangeCheck = SubscrExpr::LOOP_CHECKED;
+			(*it)->rangeLoop = rs;
+
+			bool found = false;
+			for (std::vector<Identifier *>::iterator jt = rs->rangeCheckedArrays.begin();
+					jt != rs->rangeCheckedArrays.end(); ++jt) {
+				if ((*jt)->symbol == array->symbol)
+					found = true;
+			}
+			if (!found)
+				rs->rangeCheckedArrays.push_back(array);
+		}
+	}
+
+	loops_.pop_back();
+	return;
+}
+
+void BoundsChecker::visit(ReturnStmt *rs) {
+	assert(rs != NULL);
+
+	if (rs->expr != NULL)
+		rs->expr->accept(this);
+
+	return;
+}
+
+void BoundsChecker::visit(NamespaceStmt *ns) {
+	assert(ns != NULL);
+
+	for (std::vector<Stmt *>::iterator it = ns->stmts.begin(); it != ns->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+// labels in the body allow the loop to be entered without executing the check before it,
+// and subroutines may change anything
+void BoundsChecker::visit(LabelStmt *ls) {
+	invalidateLoops();
+	return;
+}
+
+void BoundsChecker::visit(GotoStmt *gs) {
+	invalidateLoops();
+	return;
+}
+
+void BoundsChecker::visit(GosubStmt *gs) {
+	invalidateLoops();
+	return;
+}
+
+// variables are read through DerefExpr, so the references in the other places
+// might be used to modify them (e.g. ref parameters)
+void BoundsChecker::visit(Identifier *id) {
+	assert(id != NULL);
+
+	if (id->type == NULL || id->type->isRef())
+		markModified(id);
+
+	return;
+}
+
+void BoundsChecker::visit(StaticMemberExpr *sme) {
+	assert(sme != NULL);
+
+	if (sme->type == NULL || sme->type->isRef())
+		markModified(sme);
+
+	return;
+}
+
+void BoundsChecker::visit(BinaryExpr *be) {
+	assert(be != NULL);
+
+	be->lhs->accept(this);
+	be->rhs->accept(this);
+	return;
+}
+
+void BoundsChecker::visit(UnaryExpr *ue) {
+	assert(ue != NULL);
+
+	ue->rhs->accept(this);
+	return;
+}
+
+void BoundsChecker::visit(ArrayLiteralExpr *ale) {
+	assert(ale != NULL);
+
+	for (std::vector<Expr *>::iterator it = ale->elements.begin(); it != ale->elements.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void BoundsChecker::visit(FuncCallExpr *fce) {
+	assert(fce != NULL);
+
+	if (fce->func->getASTType() == AST::MEMBER_EXPR) {
+		// every built-in method of arrays but length changes its length
+		MemberExpr *me = static_cast<MemberExpr *>(fce->func);
+		if (isArray(me->receiver->type) && !isLength(me))
+			invalidateLoops();
+
+		visitLvalue(me->receiver);
+	} else if (fce->func->getASTType() == AST::IDENTIFIER
+			&& static_cast<Identifier *>(fce->func)->symbol->getSymbolType() == Symbol::EXTERN_SYMBOL) {
+		// extern functions can modify only the arguments passed by reference
+	} else {
+		invalidateLoops();
+	}
+
+	for (std::vector<Expr *>::iterator it = fce->params.begin(); it != fce->params.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void BoundsChecker::visit(ConstructorExpr *ce) {
+	assert(ce != NULL);
+
+	for (std::vector<Expr *>::iterator it = ce->params.begin(); it != ce->params.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void BoundsChecker::visit(SubscrExpr *se) {
+	assert(se != NULL);
+
+	se->rangeCheck = SubscrExpr::CHECKED;
+
+	visitLvalue(se->array);
+
+	Loop *loop = findLoopOf(se->subscript);
+	if (loop != NULL && se->array->getASTType() == AST::IDENTIFIER) {
+		Symbol *array = static_cast<Identifier *>(se->array)->symbol;
+		if (array->getSymbolType() == Symbol::VAR_SYMBOL && !loop->defined.count(array))
+			loop->subscripts.push_back(se);
+		return;
+	}
+
+	se->subscript->accept(this);
+	return;
+}
+
+void BoundsChecker::visit(MemberExpr *me) {
+	assert(me != NULL);
+
+	visitLvalue(me->receiver);
+	return;
+}
+
+void BoundsChecker::visit(RefExpr *re) {
+	assert(re != NULL);
+
+	markModified(re->refered);
+	visitLvalue(re->refered);
+	return;
+}
+
+void BoundsChecker::visit(DerefExpr *de) {
+	assert(de != NULL);
+
+	// just reading the variable
+	visitLvalue(de->derefered);
+	return;
+}
+
+}
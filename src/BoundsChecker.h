@@ -0,0 +1,95 @@
+#ifndef PERYAN_BOUNDS_CHECKER_H__
+#define PERYAN_BOUNDS_CHECKER_H__
+
+#include <set>
+#include <vector>
+
+#include "SymbolTable.h"
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace Peryan {
+
+class Options;
+class WarningPrinter;
+
+// BoundsChecker decides how each array subscript is range checked (with --bounds-check).
+class BoundsChecker : public ASTVisitor {
+private:
+	BoundsChecker(const BoundsChecker&);
+	BoundsChecker& operator=(const BoundsChecker&);
+
+	SymbolTable& symbolTable_;
+	Options& options_;
+	WarningPrinter& wp_;
+
+	// repeat loop enclosing the current node
+	class Loop {
+	public:
+		RepeatStmt *stmt;
+		Symbol *counter;
+		// the array whose length is the count of the loop (or NULL)
+		Symbol *lengthOf;
+		// the body changes neither the length of any array nor the counter
+		bool invariant;
+		// variables defined in the body
+		std::set<Symbol *> defined;
+		// subscripts of arrays by the counter
+		std::vector<SubscrExpr *> subscripts;
+	};
+	std::vector<Loop> loops_;
+
+	void invalidateLoops();
+	void markModified(Expr *expr);
+	void visitLvalue(Expr *expr);
+	Loop *findLoopOf(Expr *subscript);
+public:
+	BoundsChecker(SymbolTable& symbolTable, Options& options, WarningPrinter& wp)
+		: symbolTable_(symbolTable), options_(options), wp_(wp), loops_() {}
+
+	virtual void visit(TransUnit *tu);
+
+	virtual void visit(FuncDefStmt *fds);
+	virtual void visit(VarDefStmt *vds);
+	virtual void visit(AssignStmt *as);
+	virtual void visit(CompStmt *cs);
+	virtual void visit(IfStmt *is);
+	virtual void visit(RepeatStmt *rs);
+	virtual void visit(ReturnStmt *rs);
+	virtual void visit(NamespaceStmt *ns);
+	virtual void visit(LabelStmt *ls);
+	virtual void visit(GotoStmt *gs);
+	virtual void visit(GosubStmt *gs);
+	virtual void visit(Identifier *id);
+	virtual void visit(BinaryExpr *be);
+	virtual void visit(UnaryExpr *ue);
+	virtual void visit(ArrayLiteralExpr *ale);
+	virtual void visit(FuncCallExpr *fce);
+	virtual void visit(ConstructorExpr *ce);
+	virtual void visit(SubscrExpr *se);
+	virtual void visit(MemberExpr *me);
+	virtual void visit(StaticMemberExpr *sme);
+	virtual void visit(RefExpr *re);
+	virtual void visit(DerefExpr *de);
+
+	virtual void visit(Label *label)		{ return; }
+	virtual void visit(ExternStmt *es)		{ return; }
+	virtual void visit(ContinueStmt *cs)		{ return; }
+	virtual void visit(BreakStmt *bs)		{ return; }
+
+	virtual void visit(TypeSpec *ts)		{ return; }
+	virtual void visit(ArrayTypeSpec *ats)		{ return; }
+	virtual void visit(FuncTypeSpec *fts)		{ return; }
+	virtual void visit(MemberTypeSpec *mts)		{ return; }
+
+	virtual void visit(StrLiteralExpr *sle)		{ return; }
+	virtual void visit(IntLiteralExpr *ile)		{ return; }
+	virtual void visit(FloatLiteralExpr *fle)	{ return; }
+	virtual void visit(CharLiteralExpr *cle)	{ return; }
+	virtual void visit(BoolLiteralExpr *ble)	{ return; }
+	virtual void visit(FuncExpr *fe)		{ return; }
+};
+
+}
+
+#endif
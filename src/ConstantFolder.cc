@@ -0,0 +1,727 @@
+// ConstantFolder evaluates constant expressions at compile time so that they cost nothing at runtime.
+// It works in two passes over the typed AST:
+// - the first pass collects variable definitions and variables which are assigned or referenced
+// - the second pass folds BinaryExpr, UnaryExpr and casting ConstructorExpr whose operands are literals,
+//   and propagates variables which are never modified
+// A variable of the main code is propagated only if it is never read before its definition is executed
+// (directly or by the functions called before it), since it is zero until then.
+// The main code with labels may jump over the definitions, so its variables are not propagated at all.
+// Expressions whose evaluation fails at runtime (e.g. division by zero) are left as they are.
+
+#include <cassert>
+#include <cstring>
+#include <climits>
+#include <sstream>
+
+#include "AST.h"
+#include "SymbolTable.h"
+#include "ConstantFolder.h"
+#include "Options.h"
+#include "WarningPrinter.h"
+
+namespace Peryan {
+
+ConstantFolder::ConstantFolder(SymbolTable& symbolTable, Options& options, WarningPrinter& wp)
+	: symbolTable_(symbolTable), options_(options), wp_(wp)
+	, Int_		(symbolTable_.Int_)
+	, String_	(symbolTable_.String_)
+	, Char_		(symbolTable_.Char_)
+	, Double_	(symbolTable_.Double_)
+	, Bool_		(symbolTable_.Bool_)
+	, folding_(false)
+	, curFunc_(NULL)
+	, hasLabels_(false)
+	, rewriteWith_(NULL) {}
+
+static bool isLiteral(Expr *expr) {
+	switch (expr->getASTType()) {
+	case AST::INT_LITERAL_EXPR:
+	case AST::FLOAT_LITERAL_EXPR:
+	case AST::CHAR_LITERAL_EXPR:
+	case AST::BOOL_LITERAL_EXPR:
+	case AST::STR_LITERAL_EXPR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ConstantFolder::visit(TransUnit *tu) {
+	for (folding_ = false; ; folding_ = true) {
+		for (std::vector<Stmt *>::iterator it = tu->stmts.begin(); it != tu->stmts.end(); ++it) {
+			(*it)->accept(this);
+		}
+		if (folding_)
+			break;
+
+		findReadsBeforeDefinition();
+	}
+
+	return;
+}
+
+// remember the variables and the functions which each function and the main code refer to
+void ConstantFolder::noteReference(Symbol *symbol) {
+	if (folding_ || symbol == NULL)
+		return;
+
+	if (curFunc_ != NULL) {
+		references_[curFunc_].insert(symbol);
+	} else if (symbol->getSymbolType() == Symbol::FUNC_SYMBOL) {
+		// the function may read the variables defined after this point
+		mainCalls_.push_back(std::make_pair(symbol, static_cast<int>(mainOrder_.size())));
+	} else if (!mainOrder_.count(symbol)) {
+		readBeforeDefinition_.insert(symbol);
+	}
+
+	return;
+}
+
+// the variables of the main code which the functions called before their definitions read
+void ConstantFolder::findReadsBeforeDefinition() {
+	for (std::vector<std::pair<Symbol *, int> >::iterator call = mainCalls_.begin();
+			call != mainCalls_.end(); ++call) {
+		std::set<Symbol *> visited;
+		std::vector<Symbol *> funcs(1, call->first);
+		while (!funcs.empty()) {
+			Symbol *func = funcs.back();
+			funcs.pop_back();
+			if (!visited.insert(func).second)
+				continue;
+
+			std::set<Symbol *>& refs = references_[func];
+			for (std::set<Symbol *>::iterator it = refs.begin(); it != refs.end(); ++it) {
+				if ((*it)->getSymbolType() == Symbol::FUNC_SYMBOL) {
+					funcs.push_back(*it);
+				} else if (mainOrder_.count(*it) && mainOrder_[*it] >= call->second) {
+					readBeforeDefinition_.insert(*it);
+				}
+			}
+		}
+	}
+
+	return;
+}
+
+bool ConstantFolder::isPropagatable(Type *type) {
+	if (type == NULL || type->isRef())
+		return false;
+
+	type = type->unmodify();
+	return type->is(Int_) || type->is(Char_) || type->is(Bool_)
+		|| type->is(Double_) || type->is(String_);
+}
+
+Symbol *ConstantFolder::getRootSymbol(Expr *expr) {
+	while (true) {
+		switch (expr->getASTType()) {
+		case AST::IDENTIFIER:
+			return static_cast<Identifier *>(expr)->symbol;
+		case AST::STATIC_MEMBER_EXPR:
+			return static_cast<StaticMemberExpr *>(expr)->member->symbol;
+		case AST::SUBSCR_EXPR:
+			expr = static_cast<SubscrExpr *>(expr)->array;
+			break;
+		case AST::MEMBER_EXPR:
+			expr = static_cast<MemberExpr *>(expr)->receiver;
+			break;
+		case AST::REF_EXPR:
+			expr = static_cast<RefExpr *>(expr)->refered;
+			break;
+		case AST::DEREF_EXPR:
+			expr = static_cast<DerefExpr *>(expr)->derefered;
+			break;
+		default:
+			return NULL;
+		}
+	}
+}
+
+void ConstantFolder::markModified(Expr *expr) {
+	if (folding_)
+		return;
+
+	Symbol *symbol = getRootSymbol(expr);
+	if (symbol != NULL)
+		modified_.insert(symbol);
+	return;
+}
+
+// returns the literal which the variable always has (or NULL if it is not constant)
+Expr *ConstantFolder::getConstant(Symbol *symbol) {
+	if (!folding_ || symbol == NULL || modified_.count(symbol))
+		return NULL;
+
+	// the variable of the main code may be read while it is still zero
+	if (mainOrder_.count(symbol) && (hasLabels_ || readBeforeDefinition_.count(symbol)))
+		return NULL;
+
+	std::map<Symbol *, VarDefStmt *>::iterator it = definitions_.find(symbol);
+	if (it == definitions_.end())
+		return NULL;
+
+	VarDefStmt *vds = it->second;
+	if (vds->init == NULL)
+		return NULL;
+
+	// the definition may appear after the reference
+	if (!folded_.count(vds)) {
+		if (inProgress_.count(vds))
+			return NULL;
+
+		inProgress_.insert(vds);
+		vds->init->accept(this);
+		vds->init = refresh(vds->init);
+		inProgress_.erase(vds);
+
+		folded_.insert(vds);
+	}
+
+	return isLiteral(vds->init) ? vds->init : NULL;
+}
+
+void ConstantFolder::visit(FuncDefStmt *fds) {
+	assert(fds != NULL);
+
+	// the body wasn't resolved since nothing refers to the function
+	if (fds->symbol->isUnused)
+		return;
+
+	Symbol *prevFunc = curFunc_;
+	curFunc_ = fds->symbol;
+	fds->body->accept(this);
+	curFunc_ = prevFunc;
+	return;
+}
+
+void ConstantFolder::visit(VarDefStmt *vds) {
+	assert(vds != NULL);
+
+	if (!folding_) {
+		if (isPropagatable(vds->symbol->getType()))
+			definitions_[vds->symbol] = vds;
+	}
+
+	if (vds->init != NULL && !folded_.count(vds)) {
+		vds->init->accept(this);
+		vds->init = refresh(vds->init);
+
+		if (folding_)
+			folded_.insert(vds);
+	}
+
+	// the variables of the main code in the order of their definitions
+	if (!folding_ && curFunc_ == NULL)
+		mainOrder_.insert(std::make_pair(vds->symbol, static_cast<int>(mainOrder_.size())));
+
+	return;
+}
+
+void ConstantFolder::visit(AssignStmt *as) {
+	assert(as != NULL);
+
+	markModified(as->lhs);
+	visitWithoutFolding(as->lhs);
+
+	if (as->rhs != NULL) {
+		as->rhs->accept(this);
+		as->rhs = refresh(as->rhs);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(CompStmt *cs) {
+	assert(cs != NULL);
+
+	for (std::vector<Stmt *>::iterator it = cs->stmts.begin(); it != cs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(IfStmt *is) {
+	assert(is != NULL);
+
+	for (std::vector<Expr *>::iterator it = is->ifCond.begin(); it != is->ifCond.end(); ++it) {
+		(*it)->accept(this);
+		*it = refresh(*it);
+	}
+
+	for (std::vector<CompStmt *>::iterator it = is->ifThen.begin(); it != is->ifThen.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	if (is->elseThen != NULL)
+		is->elseThen->accept(this);
+
+	return;
+}
+
+void ConstantFolder::visit(RepeatStmt *rs) {
+	assert(rs != NULL);
+
+	if (rs->count != NULL) {
+		rs->count->accept(this);
+		rs->count = refresh(rs->count);
+	}
+
+	// the counter can live in a register unless the body may modify it
+	if (folding_)
+		rs->isCounterModified = modified_.count(rs->scope->resolve("cnt", rs->token.getPosition())) > 0;
+
+	for (std::vector<Stmt *>::iterator it = rs->stmts.begin(); it != rs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(ReturnStmt *rs) {
+	assert(rs != NULL);
+
+	if (rs->expr != NULL) {
+		rs->expr->accept(this);
+		rs->expr = refresh(rs->expr);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(NamespaceStmt *ns) {
+	assert(ns != NULL);
+
+	for (std::vector<Stmt *>::iterator it = ns->stmts.begin(); it != ns->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+// variables are referred as references and read through DerefExpr,
+// so the references in the other places might be used to modify them (e.g. ref parameters)
+void ConstantFolder::visit(Identifier *id) {
+	assert(id != NULL);
+
+	noteReference(id->symbol);
+
+	if (id->type == NULL || id->type->isRef()) {
+		markModified(id);
+		return;
+	}
+
+	Expr *constant = getConstant(id->symbol);
+	if (constant != NULL)
+		rewrite(copyLiteral(constant, id));
+
+	return;
+}
+
+void ConstantFolder::visit(StaticMemberExpr *sme) {
+	assert(sme != NULL);
+
+	noteReference(sme->member->symbol);
+
+	if (sme->type == NULL || sme->type->isRef()) {
+		markModified(sme);
+		return;
+	}
+
+	Expr *constant = getConstant(sme->member->symbol);
+	if (constant != NULL)
+		rewrite(copyLiteral(constant, sme));
+
+	return;
+}
+
+void ConstantFolder::visit(BinaryExpr *be) {
+	assert(be != NULL);
+
+	be->lhs->accept(this);
+	be->lhs = refresh(be->lhs);
+
+	be->rhs->accept(this);
+	be->rhs = refresh(be->rhs);
+
+	if (!folding_)
+		return;
+
+	Expr *folded = foldBinaryExpr(be);
+	if (folded != NULL)
+		rewrite(folded);
+
+	return;
+}
+
+void ConstantFolder::visit(UnaryExpr *ue) {
+	assert(ue != NULL);
+
+	ue->rhs->accept(this);
+	ue->rhs = refresh(ue->rhs);
+
+	if (!folding_)
+		return;
+
+	Expr *folded = foldUnaryExpr(ue);
+	if (folded != NULL)
+		rewrite(folded);
+
+	return;
+}
+
+void ConstantFolder::visit(ArrayLiteralExpr *ale) {
+	assert(ale != NULL);
+
+	for (std::vector<Expr *>::iterator it = ale->elements.begin(); it != ale->elements.end(); ++it) {
+		(*it)->accept(this);
+		*it = refresh(*it);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(FuncCallExpr *fce) {
+	assert(fce != NULL);
+
+	visitWithoutFolding(fce->func);
+
+	for (std::vector<Expr *>::iterator it = fce->params.begin(); it != fce->params.end(); ++it) {
+		(*it)->accept(this);
+		*it = refresh(*it);
+	}
+
+	return;
+}
+
+void ConstantFolder::visit(ConstructorExpr *ce) {
+	assert(ce != NULL);
+
+	for (std::vector<Expr *>::iterator it = ce->params.begin(); it != ce->params.end(); ++it) {
+		(*it)->accept(this);
+		*it = refresh(*it);
+	}
+
+	if (!folding_)
+		return;
+
+	Expr *folded = foldConstructorExpr(ce);
+	if (folded != NULL)
+		rewrite(folded);
+
+	return;
+}
+
+void ConstantFolder::visit(SubscrExpr *se) {
+	assert(se != NULL);
+
+	visitWithoutFolding(se->array);
+
+	se->subscript->accept(this);
+	se->subscript = refresh(se->subscript);
+
+	return;
+}
+
+void ConstantFolder::visit(MemberExpr *me) {
+	assert(me != NULL);
+
+	visitWithoutFolding(me->receiver);
+	return;
+}
+
+void ConstantFolder::visit(RefExpr *re) {
+	assert(re != NULL);
+
+	markModified(re->refered);
+	visitWithoutFolding(re->refered);
+	return;
+}
+
+void ConstantFolder::visit(DerefExpr *de) {
+	assert(de != NULL);
+
+	Symbol *symbol = NULL;
+	if (de->derefered->getASTType() == AST::IDENTIFIER) {
+		symbol = static_cast<Identifier *>(de->derefered)->symbol;
+	} else if (de->derefered->getASTType() == AST::STATIC_MEMBER_EXPR) {
+		symbol = static_cast<StaticMemberExpr *>(de->derefered)->member->symbol;
+	}
+
+	// just reading the variable
+	if (symbol != NULL) {
+		noteReference(symbol);
+
+		Expr *constant = getConstant(symbol);
+		if (constant != NULL)
+			rewrite(copyLiteral(constant, de));
+		return;
+	}
+
+	visitWithoutFolding(de->derefered);
+	return;
+}
+
+Expr *ConstantFolder::foldBinaryExpr(BinaryExpr *be) {
+	Expr *lhs = be->lhs, *rhs = be->rhs;
+	Type *type = lhs->type->unmodify();
+	const Token::Type op = be->token.getType();
+
+	// logical AND, OR are short-circuited, so the right hand side is not needed to be constant
+	if (type->is(Bool_) && lhs->getASTType() == AST::BOOL_LITERAL_EXPR
+			&& (op == Token::AMP || op == Token::PIPE)) {
+		const bool lhsBool = static_cast<BoolLiteralExpr *>(lhs)->bool_;
+		if (lhsBool == (op == Token::AMP)) {
+			// true & rhs, false | rhs
+			return rhs;
+		} else {
+			// false & rhs, true | rhs
+			return createBool(lhsBool, be);
+		}
+	}
+
+	// (lhs + "foo") + "bar" is the same as lhs + "foobar"
+	if (type->is(String_) && op == Token::PLUS
+			&& lhs->getASTType() == AST::BINARY_EXPR && rhs->getASTType() == AST::STR_LITERAL_EXPR) {
+		BinaryExpr *lhsBe = static_cast<BinaryExpr *>(lhs);
+		if (lhsBe->token.getType() == Token::PLUS && lhsBe->rhs->getASTType() == AST::STR_LITERAL_EXPR) {
+			lhsBe->rhs = createString(static_cast<StrLiteralExpr *>(lhsBe->rhs)->str
+					+ static_cast<StrLiteralExpr *>(rhs)->str, lhsBe->rhs);
+			return lhsBe;
+		}
+	}
+
+	if (!isLiteral(lhs) || !isLiteral(rhs))
+		return NULL;
+
+	if (type->is(Int_)) {
+		const int l = static_cast<IntLiteralExpr *>(lhs)->integer;
+		const int r = static_cast<IntLiteralExpr *>(rhs)->integer;
+
+		// wrapped around like the instructions generated by LLVMCodeGen
+		const unsigned int ul = l, ur = r;
+
+		switch (op) {
+		case Token::CARET	: return createInt(l ^ r, be);
+		case Token::PIPE	: return createInt(l | r, be);
+		case Token::AMP		: return createInt(l & r, be);
+
+		case Token::EQEQ	: return createBool(l == r, be);
+		case Token::EXCLEQ	: return createBool(l != r, be);
+		case Token::LT		: return createBool(l < r, be);
+		case Token::LTEQ	: return createBool(l <= r, be);
+		case Token::GT		: return createBool(l > r, be);
+		case Token::GTEQ	: return createBool(l >= r, be);
+
+		case Token::LTLT:
+		case Token::GTGT:
+			if (r < 0 || r >= 32)
+				return NULL;
+			// >> is logical shift
+			return createInt(static_cast<int>(op == Token::LTLT ? ul << r : ul >> r), be);
+
+		case Token::PLUS	: return createInt(static_cast<int>(ul + ur), be);
+		case Token::MINUS	: return createInt(static_cast<int>(ul - ur), be);
+		case Token::STAR	: return createInt(static_cast<int>(ul * ur), be);
+
+		case Token::SLASH:
+		case Token::PERC:
+			if (r == 0 || (l == INT_MIN && r == -1))
+				return NULL;
+			return createInt(op == Token::SLASH ? l / r : l % r, be);
+
+		default: ;
+		}
+	} else if (type->is(Double_)) {
+		const double l = static_cast<FloatLiteralExpr *>(lhs)->float_;
+		const double r = static_cast<FloatLiteralExpr *>(rhs)->float_;
+
+		// comparisons are ordered (false if either is NaN)
+		switch (op) {
+		case Token::EQEQ	: return createBool(l == r, be);
+		case Token::EXCLEQ	: return createBool(l < r || l > r, be);
+		case Token::LT		: return createBool(l < r, be);
+		case Token::LTEQ	: return createBool(l <= r, be);
+		case Token::GT		: return createBool(l > r, be);
+		case Token::GTEQ	: return createBool(l >= r, be);
+
+		case Token::PLUS	: return createDouble(l + r, be);
+		case Token::MINUS	: return createDouble(l - r, be);
+		case Token::STAR	: return createDouble(l * r, be);
+		case Token::SLASH	: return createDouble(l / r, be);
+
+		default: ;
+		}
+	} else if (type->is(Bool_)) {
+		const bool l = static_cast<BoolLiteralExpr *>(lhs)->bool_;
+		const bool r = static_cast<BoolLiteralExpr *>(rhs)->bool_;
+
+		switch (op) {
+		case Token::CARET	: return createBool(l != r, be);
+		case Token::EQEQ	: return createBool(l == r, be);
+		case Token::EXCLEQ	: return createBool(l != r, be);
+
+		default: ;
+		}
+	} else if (type->is(String_)) {
+		const std::string& l = static_cast<StrLiteralExpr *>(lhs)->str;
+		const std::string& r = static_cast<StrLiteralExpr *>(rhs)->str;
+
+		// compared as C strings like PRStringCompare
+		switch (op) {
+		case Token::EQEQ	: return createBool(strcmp(l.c_str(), r.c_str()) == 0, be);
+		case Token::EXCLEQ	: return createBool(strcmp(l.c_str(), r.c_str()) != 0, be);
+
+		case Token::PLUS	: return createString(l + r, be);
+
+		default: ;
+		}
+	}
+
+	return NULL;
+}
+
+Expr *ConstantFolder::foldUnaryExpr(UnaryExpr *ue) {
+	Expr *rhs = ue->rhs;
+	if (!isLiteral(rhs))
+		return NULL;
+
+	Type *type = rhs->type->unmodify();
+
+	switch (ue->token.getType()) {
+	case Token::PLUS:
+		return copyLiteral(rhs, ue);
+	case Token::MINUS:
+		if (type->is(Int_)) {
+			const unsigned int r = static_cast<IntLiteralExpr *>(rhs)->integer;
+			return createInt(static_cast<int>(0u - r), ue);
+		} else if (type->is(Double_)) {
+			return createDouble(-static_cast<FloatLiteralExpr *>(rhs)->float_, ue);
+		}
+		return NULL;
+	case Token::EXCL:
+		if (type->is(Bool_))
+			return createBool(!static_cast<BoolLiteralExpr *>(rhs)->bool_, ue);
+		return NULL;
+	default:
+		return NULL;
+	}
+}
+
+// casting constructors with the same semantics as LLVMCodeGen and the runtime
+Expr *ConstantFolder::foldConstructorExpr(ConstructorExpr *ce) {
+	if (ce->params.size() != 1 || !isLiteral(ce->params[0]))
+		return NULL;
+
+	Expr *prm = ce->params[0];
+	Type *from = prm->type->unmodify();
+	Type *to = ce->type;
+
+	// integer value of Bool, Char and Int
+	int integer = 0;
+	bool isInteger = true;
+	switch (prm->getASTType()) {
+	case AST::INT_LITERAL_EXPR	: integer = static_cast<IntLiteralExpr *>(prm)->integer; break;
+	case AST::CHAR_LITERAL_EXPR	: integer = static_cast<CharLiteralExpr *>(prm)->char_; break;
+	case AST::BOOL_LITERAL_EXPR	: integer = static_cast<BoolLiteralExpr *>(prm)->bool_; break;
+	default				: isInteger = false;
+	}
+
+	if (to->is(Int_) || to->is(Char_)) {
+		if (from->is(Double_)) {
+			const double float_ = static_cast<FloatLiteralExpr *>(prm)->float_;
+			if (!(INT_MIN <= float_ && float_ < -static_cast<double>(INT_MIN)))
+				return NULL;
+			integer = static_cast<int>(float_);
+		} else if (from->is(String_)) {
+			// same as PRIntConstructor
+			const std::string& str = static_cast<StrLiteralExpr *>(prm)->str;
+			if (!to->is(Int_) || str.empty())
+				return NULL;
+
+			unsigned int res = 0;
+			for (size_t i = (str[0] == '-' ? 1 : 0); i < str.size(); ++i) {
+				if (!('0' <= str[i] && str[i] <= '9'))
+					return NULL;
+				res = res * 10 + (str[i] - '0');
+			}
+			integer = static_cast<int>(str[0] == '-' ? 0u - res : res);
+		} else if (!isInteger) {
+			return NULL;
+		}
+
+		if (to->is(Int_)) {
+			return createInt(integer, ce);
+		} else {
+			return createChar(static_cast<char>(integer), ce);
+		}
+	} else if (to->is(Bool_)) {
+		if (!isInteger)
+			return NULL;
+		return createBool(integer != 0, ce);
+	} else if (to->is(Double_)) {
+		if (from->is(Double_)) {
+			return copyLiteral(prm, ce);
+		} else if (!isInteger) {
+			return NULL;
+		}
+		return createDouble(integer, ce);
+	} else if (to->is(String_)) {
+		if (from->is(String_))
+			return copyLiteral(prm, ce);
+
+		if (!from->is(Int_))
+			return NULL;
+
+		std::stringstream ss;
+		ss<<integer;
+		return createString(ss.str(), ce);
+	}
+
+	return NULL;
+}
+
+Expr *ConstantFolder::createInt(int integer, Expr *at) {
+	Expr *res = new IntLiteralExpr(Token(Token::INTEGER, integer, at->token.getPosition()));
+	res->type = at->type;
+	return res;
+}
+
+Expr *ConstantFolder::createDouble(double float_, Expr *at) {
+	Expr *res = new FloatLiteralExpr(Token(Token::FLOAT, float_, at->token.getPosition()));
+	res->type = at->type;
+	return res;
+}
+
+Expr *ConstantFolder::createChar(char char_, Expr *at) {
+	Expr *res = new CharLiteralExpr(Token(Token::CHAR, char_, at->token.getPosition()));
+	res->type = at->type;
+	return res;
+}
+
+Expr *ConstantFolder::createBool(bool bool_, Expr *at) {
+	Expr *res = new BoolLiteralExpr(Token(bool_ ? Token::KW_TRUE : Token::KW_FALSE, at->token.getPosition()));
+	res->type = at->type;
+	return res;
+}
+
+Expr *ConstantFolder::createString(const std::string& str, Expr *at) {
+	Expr *res = new StrLiteralExpr(Token(Token::STRING, str, at->token.getPosition()));
+	res->type = at->type;
+	return res;
+}
+
+Expr *ConstantFolder::copyLiteral(Expr *literal, Expr *at) {
+	switch (literal->getASTType()) {
+	case AST::INT_LITERAL_EXPR	: return createInt(static_cast<IntLiteralExpr *>(literal)->integer, at);
+	case AST::FLOAT_LITERAL_EXPR	: return createDouble(static_cast<FloatLiteralExpr *>(literal)->float_, at);
+	case AST::CHAR_LITERAL_EXPR	: return createChar(static_cast<CharLiteralExpr *>(literal)->char_, at);
+	case AST::BOOL_LITERAL_EXPR	: return createBool(static_cast<BoolLiteralExpr *>(literal)->bool_, at);
+	case AST::STR_LITERAL_EXPR	: return createString(static_cast<StrLiteralExpr *>(literal)->str, at);
+	default:
+		assert(false && "not a literal");
+		return NULL;
+	}
+}
+
+};
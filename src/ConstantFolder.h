@@ -0,0 +1,140 @@
+#ifndef PERYAN_CONSTANT_FOLDER_H__
+#define PERYAN_CONSTANT_FOLDER_H__
+
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SymbolTable.h"
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace Peryan {
+
+class Options;
+class WarningPrinter;
+
+// ConstantFolder folds constant expressions after TypeResolver.
+class ConstantFolder : public ASTVisitor {
+private:
+	ConstantFolder(const ConstantFolder&);
+	ConstantFolder& operator=(const ConstantFolder&);
+
+	SymbolTable& symbolTable_;
+	Options& options_;
+	WarningPrinter& wp_;
+
+	Type *Int_, *String_, *Char_, *Double_, *Bool_;
+
+	// false while collecting the definitions and the modified variables
+	bool folding_;
+
+	// variables which are defined by VarDefStmt and can be propagated
+	std::map<Symbol *, VarDefStmt *> definitions_;
+	// variables which are assigned or referenced (thus cannot be propagated)
+	std::set<Symbol *> modified_;
+
+	std::set<VarDefStmt *> folded_, inProgress_;
+
+	// the function whose body is visited (NULL in the main code)
+	Symbol *curFunc_;
+	// variables and functions which each function refers to
+	std::map<Symbol *, std::set<Symbol *> > references_;
+	// variables of the main code and the order of their definitions
+	std::map<Symbol *, int> mainOrder_;
+	// functions referred by the main code and the number of the variables defined before that
+	std::vector<std::pair<Symbol *, int> > mainCalls_;
+	// variables of the main code which may be read before their definitions
+	std::set<Symbol *> readBeforeDefinition_;
+	bool hasLabels_;
+
+	bool isPropagatable(Type *type);
+	Symbol *getRootSymbol(Expr *expr);
+	void markModified(Expr *expr);
+	Expr *getConstant(Symbol *symbol);
+	void noteReference(Symbol *symbol);
+	void findReadsBeforeDefinition();
+
+	Expr *foldBinaryExpr(BinaryExpr *be);
+	Expr *foldUnaryExpr(UnaryExpr *ue);
+	Expr *foldConstructorExpr(ConstructorExpr *ce);
+
+	Expr *createInt(int integer, Expr *at);
+	Expr *createDouble(double float_, Expr *at);
+	Expr *createChar(char char_, Expr *at);
+	Expr *createBool(bool bool_, Expr *at);
+	Expr *createString(const std::string& str, Expr *at);
+	Expr *copyLiteral(Expr *literal, Expr *at);
+
+	Expr *rewriteWith_;
+	Expr *refresh(Expr *from) {
+		if (rewriteWith_ == NULL) {
+			return from;
+		} else {
+			from = rewriteWith_;
+			rewriteWith_ = NULL;
+			return from;
+		}
+	}
+	void rewrite(Expr *rewriteWith) {
+		if (folding_)
+			rewriteWith_ = rewriteWith;
+		return;
+	}
+
+	// fold the subexpressions but leave the expression itself (e.g. lvalues)
+	void visitWithoutFolding(Expr *expr) {
+		expr->accept(this);
+		rewriteWith_ = NULL;
+		return;
+	}
+public:
+	ConstantFolder(SymbolTable& symbolTable, Options& options, WarningPrinter& wp);
+
+	virtual void visit(TransUnit *tu);
+
+	virtual void visit(FuncDefStmt *fds);
+	virtual void visit(VarDefStmt *vds);
+	virtual void visit(AssignStmt *as);
+	virtual void visit(CompStmt *cs);
+	virtual void visit(IfStmt *is);
+	virtual void visit(RepeatStmt *rs);
+	virtual void visit(ReturnStmt *rs);
+	virtual void visit(NamespaceStmt *ns);
+	virtual void visit(Identifier *id);
+	virtual void visit(BinaryExpr *be);
+	virtual void visit(UnaryExpr *ue);
+	virtual void visit(ArrayLiteralExpr *ale);
+	virtual void visit(FuncCallExpr *fce);
+	virtual void visit(ConstructorExpr *ce);
+	virtual void visit(SubscrExpr *se);
+	virtual void visit(MemberExpr *me);
+	virtual void visit(StaticMemberExpr *sme);
+	virtual void visit(RefExpr *re);
+	virtual void visit(DerefExpr *de);
+
+	virtual void visit(Label *label)		{ return; }
+	virtual void visit(LabelStmt *ls)		{ hasLabels_ = true; return; }
+	virtual void visit(ExternStmt *es)		{ return; }
+	virtual void visit(GotoStmt *gs)		{ return; }
+	virtual void visit(GosubStmt *gs)		{ return; }
+	virtual void visit(ContinueStmt *cs)		{ return; }
+	virtual void visit(BreakStmt *bs)		{ return; }
+
+	virtual void visit(TypeSpec *ts)		{ return; }
+	virtual void visit(ArrayTypeSpec *ats)		{ return; }
+	virtual void visit(FuncTypeSpec *fts)		{ return; }
+	virtual void visit(MemberTypeSpec *mts)		{ return; }
+
+	virtual void visit(StrLiteralExpr *sle)		{ return; }
+	virtual void visit(IntLiteralExpr *ile)		{ return; }
+	virtual void visit(FloatLiteralExpr *fle)	{ return; }
+	virtual void visit(CharLiteralExpr *cle)	{ return; }
+	virtual void visit(BoolLiteralExpr *ble)	{ return; }
+	virtual void visit(FuncExpr *fe)		{ return; }
+};
+
+}
+
+#endif
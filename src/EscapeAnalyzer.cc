@@ -0,0 +1,311 @@
+// EscapeAnalyzer finds the global variables which can be the local variables of the main function.
+// Global variables are emitted as module globals, which every call may clobber,
+// so a global variable which no function refers to is allocated in the main function instead
+// (VarSymbol::isMainLocal) and can live in a register.
+// Labels are basic blocks of the main function, so the code after them is the main code as well.
+// It also finds the repeat loops whose body contains gosub (RepeatStmt::hasGosub):
+// since the return of the subroutine jumps back into the body, their counters must be in the memory.
+// The elements of a local array in a function are allocated on the stack (VarSymbol::stackCapacity)
+// if its size is small and constant and nothing can reallocate or free them:
+// copies of arrays have their own elements, so only assigning the whole array, referring to it
+// (e.g. passing it by reference) and the methods which grow it (push, insert, resize and reserve)
+// let the elements escape.
+
+#include <cassert>
+
+#include "AST.h"
+#include "SymbolTable.h"
+#include "EscapeAnalyzer.h"
+#include "Options.h"
+#include "WarningPrinter.h"
+
+namespace Peryan {
+
+// max number of the elements allocated on the stack
+static const int kMaxStackArrayLength = 64;
+
+void EscapeAnalyzer::visit(TransUnit *tu) {
+	for (std::vector<Stmt *>::iterator it = tu->stmts.begin(); it != tu->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	markMainLocals(tu->scope);
+
+	for (std::map<Symbol *, int>::iterator it = stackArrays_.begin(); it != stackArrays_.end(); ++it) {
+		if (!escaped_.count(it->first))
+			static_cast<VarSymbol *>(it->first)->stackCapacity = it->second;
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::markReferenced(Symbol *symbol) {
+	if (inFunction_ && symbol != NULL && symbol->getSymbolType() == Symbol::VAR_SYMBOL)
+		shared_.insert(symbol);
+
+	return;
+}
+
+void EscapeAnalyzer::markMainLocals(Scope *scope) {
+	for (Scope::iterator it = scope->begin(); it != scope->end(); ++it) {
+		if ((*it)->getSymbolType() == Symbol::VAR_SYMBOL) {
+			static_cast<VarSymbol *>(*it)->isMainLocal = !shared_.count(*it);
+		} else if ((*it)->getSymbolType() == Symbol::NAMESPACE_SYMBOL) {
+			markMainLocals(static_cast<NamespaceSymbol *>(*it));
+		}
+	}
+
+	return;
+}
+
+// expr (the array itself) may be reallocated or freed
+void EscapeAnalyzer::markEscaped(Expr *expr) {
+	if (expr->getASTType() == AST::DEREF_EXPR)
+		expr = static_cast<DerefExpr *>(expr)->derefered;
+
+	if (expr->getASTType() == AST::IDENTIFIER)
+		escaped_.insert(static_cast<Identifier *>(expr)->symbol);
+
+	return;
+}
+
+// visit expr which is used as an lvalue (read, subscripted or assigned) without letting it escape
+void EscapeAnalyzer::visitLvalue(Expr *expr) {
+	if (expr->getASTType() == AST::IDENTIFIER)
+		markReferenced(static_cast<Identifier *>(expr)->symbol);
+	else
+		expr->accept(this);
+
+	return;
+}
+
+void EscapeAnalyzer::visit(FuncDefStmt *fds) {
+	assert(fds != NULL);
+
+	// the body wasn't resolved since nothing refers to the function
+	if (fds->symbol->isUnused)
+		return;
+
+	const bool outerInFunction = inFunction_;
+	inFunction_ = true;
+
+	// the default arguments are evaluated by the callers
+	for (std::vector<Expr *>::iterator it = fds->defaults.begin(); it != fds->defaults.end(); ++it) {
+		if (*it != NULL)
+			(*it)->accept(this);
+	}
+
+	fds->body->accept(this);
+
+	inFunction_ = outerInFunction;
+	return;
+}
+
+void EscapeAnalyzer::visit(VarDefStmt *vds) {
+	assert(vds != NULL);
+
+	// [T](n) with constant n or array literal
+	Type *type = vds->symbol->getType();
+	if (inFunction_ && vds->init != NULL && !type->isRef() && type->getTypeType() == Type::ARRAY_TYPE) {
+		int length = 0;
+		if (vds->init->getASTType() == AST::ARRAY_LITERAL_EXPR) {
+			length = static_cast<ArrayLiteralExpr *>(vds->init)->elements.size();
+		} else if (vds->init->getASTType() == AST::CONSTRUCTOR_EXPR) {
+			ConstructorExpr *ce = static_cast<ConstructorExpr *>(vds->init);
+			if (!ce->params.empty() && ce->params[0]->getASTType() == AST::INT_LITERAL_EXPR)
+				length = static_cast<IntLiteralExpr *>(ce->params[0])->integer;
+		}
+
+		if (0 < length && length <= kMaxStackArrayLength)
+			stackArrays_[vds->symbol] = length;
+	}
+
+	if (vds->init != NULL)
+		vds->init->accept(this);
+
+	return;
+}
+
+void EscapeAnalyzer::visit(AssignStmt *as) {
+	assert(as != NULL);
+
+	markEscaped(as->lhs);
+	visitLvalue(as->lhs);
+
+	if (as->rhs != NULL)
+		as->rhs->accept(this);
+
+	return;
+}
+
+void EscapeAnalyzer::visit(CompStmt *cs) {
+	assert(cs != NULL);
+
+	for (std::vector<Stmt *>::iterator it = cs->stmts.begin(); it != cs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::visit(IfStmt *is) {
+	assert(is != NULL);
+
+	for (std::vector<Expr *>::iterator it = is->ifCond.begin(); it != is->ifCond.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	for (std::vector<CompStmt *>::iterator it = is->ifThen.begin(); it != is->ifThen.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	if (is->elseThen != NULL)
+		is->elseThen->accept(this);
+
+	return;
+}
+
+void EscapeAnalyzer::visit(RepeatStmt *rs) {
+	assert(rs != NULL);
+
+	if (rs->count != NULL)
+		rs->count->accept(this);
+
+	const int outerGosubs = gosubs_;
+
+	for (std::vector<Stmt *>::iterator it = rs->stmts.begin(); it != rs->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	rs->hasGosub = (gosubs_ != outerGosubs);
+	return;
+}
+
+void EscapeAnalyzer::visit(ReturnStmt *rs) {
+	assert(rs != NULL);
+
+	if (rs->expr != NULL)
+		rs->expr->accept(this);
+
+	return;
+}
+
+void EscapeAnalyzer::visit(NamespaceStmt *ns) {
+	assert(ns != NULL);
+
+	for (std::vector<Stmt *>::iterator it = ns->stmts.begin(); it != ns->stmts.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::visit(GosubStmt *gs) {
+	gosubs_++;
+	return;
+}
+
+// variables are read through DerefExpr, so the references in the other places
+// might be kept or modified by others (e.g. ref parameters)
+void EscapeAnalyzer::visit(Identifier *id) {
+	assert(id != NULL);
+
+	if (id->type == NULL || id->type->isRef())
+		markEscaped(id);
+
+	markReferenced(id->symbol);
+	return;
+}
+
+void EscapeAnalyzer::visit(StaticMemberExpr *sme) {
+	assert(sme != NULL);
+
+	markReferenced(sme->member->symbol);
+	return;
+}
+
+void EscapeAnalyzer::visit(BinaryExpr *be) {
+	assert(be != NULL);
+
+	be->lhs->accept(this);
+	be->rhs->accept(this);
+	return;
+}
+
+void EscapeAnalyzer::visit(UnaryExpr *ue) {
+	assert(ue != NULL);
+
+	ue->rhs->accept(this);
+	return;
+}
+
+void EscapeAnalyzer::visit(ArrayLiteralExpr *ale) {
+	assert(ale != NULL);
+
+	for (std::vector<Expr *>::iterator it = ale->elements.begin(); it != ale->elements.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::visit(FuncCallExpr *fce) {
+	assert(fce != NULL);
+
+	if (fce->func->getASTType() == AST::MEMBER_EXPR) {
+		MemberExpr *me = static_cast<MemberExpr *>(fce->func);
+		const std::string& member = me->member->getString();
+		if (member == "push" || member == "insert" || member == "resize" || member == "reserve")
+			markEscaped(me->receiver);
+	}
+
+	fce->func->accept(this);
+
+	for (std::vector<Expr *>::iterator it = fce->params.begin(); it != fce->params.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::visit(ConstructorExpr *ce) {
+	assert(ce != NULL);
+
+	for (std::vector<Expr *>::iterator it = ce->params.begin(); it != ce->params.end(); ++it) {
+		(*it)->accept(this);
+	}
+
+	return;
+}
+
+void EscapeAnalyzer::visit(SubscrExpr *se) {
+	assert(se != NULL);
+
+	visitLvalue(se->array);
+	se->subscript->accept(this);
+	return;
+}
+
+void EscapeAnalyzer::visit(MemberExpr *me) {
+	assert(me != NULL);
+
+	visitLvalue(me->receiver);
+	return;
+}
+
+void EscapeAnalyzer::visit(RefExpr *re) {
+	assert(re != NULL);
+
+	markEscaped(re->refered);
+	visitLvalue(re->refered);
+	return;
+}
+
+void EscapeAnalyzer::visit(DerefExpr *de) {
+	assert(de != NULL);
+
+	visitLvalue(de->derefered);
+	return;
+}
+
+}
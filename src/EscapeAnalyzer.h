@@ -0,0 +1,94 @@
+#ifndef PERYAN_ESCAPE_ANALYZER_H__
+#define PERYAN_ESCAPE_ANALYZER_H__
+
+#include <set>
+#include <map>
+
+#include "SymbolTable.h"
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace Peryan {
+
+class Options;
+class WarningPrinter;
+
+// EscapeAnalyzer finds the global variables which only the main code refers to,
+// the local arrays whose elements can be on the stack, and the loops which gosub returns into.
+class EscapeAnalyzer : public ASTVisitor {
+private:
+	EscapeAnalyzer(const EscapeAnalyzer&);
+	EscapeAnalyzer& operator=(const EscapeAnalyzer&);
+
+	SymbolTable& symbolTable_;
+	Options& options_;
+	WarningPrinter& wp_;
+
+	// visiting the code which is not in the main function (function bodies and default arguments)
+	bool inFunction_;
+	// number of gosub statements visited
+	int gosubs_;
+
+	// variables referred to from the outside of the main function
+	std::set<Symbol *> shared_;
+
+	// local arrays of constant size and their capacities
+	std::map<Symbol *, int> stackArrays_;
+	// local arrays whose elements may be reallocated or freed by others
+	std::set<Symbol *> escaped_;
+
+	void markReferenced(Symbol *symbol);
+	void markMainLocals(Scope *scope);
+	void markEscaped(Expr *expr);
+	void visitLvalue(Expr *expr);
+public:
+	EscapeAnalyzer(SymbolTable& symbolTable, Options& options, WarningPrinter& wp)
+		: symbolTable_(symbolTable), options_(options), wp_(wp)
+		, inFunction_(false), gosubs_(0), shared_() {}
+
+	virtual void visit(TransUnit *tu);
+
+	virtual void visit(FuncDefStmt *fds);
+	virtual void visit(VarDefStmt *vds);
+	virtual void visit(AssignStmt *as);
+	virtual void visit(CompStmt *cs);
+	virtual void visit(IfStmt *is);
+	virtual void visit(RepeatStmt *rs);
+	virtual void visit(ReturnStmt *rs);
+	virtual void visit(NamespaceStmt *ns);
+	virtual void visit(GosubStmt *gs);
+	virtual void visit(Identifier *id);
+	virtual void visit(BinaryExpr *be);
+	virtual void visit(UnaryExpr *ue);
+	virtual void visit(ArrayLiteralExpr *ale);
+	virtual void visit(FuncCallExpr *fce);
+	virtual void visit(ConstructorExpr *ce);
+	virtual void visit(SubscrExpr *se);
+	virtual void visit(MemberExpr *me);
+	virtual void visit(StaticMemberExpr *sme);
+	virtual void visit(RefExpr *re);
+	virtual void visit(DerefExpr *de);
+
+	virtual void visit(Label *label)		{ return; }
+	virtual void visit(LabelStmt *ls)		{ return; }
+	virtual void visit(GotoStmt *gs)		{ return; }
+	virtual void visit(ExternStmt *es)		{ return; }
+	virtual void visit(ContinueStmt *cs)		{ return; }
+	virtual void visit(BreakStmt *bs)		{ return; }
+
+	virtual void visit(TypeSpec *ts)		{ return; }
+	virtual void visit(ArrayTypeSpec *ats)		{ return; }
+	virtual void visit(FuncTypeSpec *fts)		{ return; }
+	virtual void visit(MemberTypeSpec *mts)		{ return; }
+
+	virtual void visit(StrLiteralExpr *sle)		{ return; }
+	virtual void visit(IntLiteralExpr *ile)		{ return; }
+	virtual void visit(FloatLiteralExpr *fle)	{ return; }
+	virtual void visit(CharLiteralExpr *cle)	{ return; }
+	virtual void visit(BoolLiteralExpr *ble)	{ return; }
+	virtual void visit(FuncExpr *fe)		{ return; }
+};
+
+}
+
+#endif
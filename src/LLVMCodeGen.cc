@@ -2,38 +2,55 @@
 // to remove LLVM dependecies from other part of the compiler
 // and to enclosure all of them in the class.
 #include <sstream>
+#include <fstream>
 #include <system_error>
 #include <deque>
+#include <map>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallString.h"
 
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/IRPrintingPasses.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/Dwarf.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/FileSystem.h"
-#include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/IPO.h"
 
 #include "SymbolTable.h"
 #include "AST.h"
 #include "Parser.h"
+#include "Lexer.h"
+#include "Options.h"
 #include "LLVMCodeGen.h"
 #include "ASTPrinter.h"
 
+#include "../runtime/layout.h"
+
 namespace Peryan {
 
 class LLVMCodeGen::Impl {
 private:
 	Parser& parser_;
+	Options& options_;
 	std::string fileName_;
 
 	llvm::LLVMContext& context_;
 	llvm::IRBuilder<> builder_;
 	llvm::Module module_;
 
-	Type *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Label_, *Void_;
+	Type *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Label_, *Void_, *Int64_;
 
 	class Block {
 	public:
@@ -48,12 +65,21 @@ private:
 
 		BlockType type;
 		llvm::Function *func;		// GLOBAL_BLOCK, FUNC_BLOCK
-		llvm::BasicBlock *head;		// COMP_BLOCK
+		llvm::BasicBlock *head;		// COMP_BLOCK, FUNC_BLOCK (after the parameters are initialized)
 		llvm::BasicBlock *body;		// GLOBAL_BLOCK, COMP_BLOCK, FUNC_BLOCK, LOOP_BLOCK
 		llvm::BasicBlock *end;		// GLOBAL_BLOCK, COMP_BLOCK, FUNC_BLOCK, LOOP_BLOCK
 		llvm::Value *retVal;		// FUNC_BLOCK
+		llvm::Value *unwindDest;	// GLOBAL_BLOCK, FUNC_BLOCK
+		llvm::DISubprogram *diScope;	// GLOBAL_BLOCK, FUNC_BLOCK (with -g)
 		llvm::BasicBlock *continue_;	// LOOP_BLOCK
 		llvm::BasicBlock *break_;	// LOOP_BLOCK
+		std::vector<llvm::AllocaInst *> params;	// FUNC_BLOCK
+		int instrumentRecord;			// FUNC_BLOCK (with --instrument)
+
+		// variables destructed at the end block
+		std::vector<std::pair<llvm::AllocaInst *, Type *> > destructed;	// COMP_BLOCK, FUNC_BLOCK, LOOP_BLOCK
+		// jumps passing the end block (id in $unwindDest, where to go after the cleanup)
+		std::vector<std::pair<int, llvm::BasicBlock *> > unwinds;		// COMP_BLOCK, LOOP_BLOCK
 
 		Block(BlockType type)
 			: type(type)
@@ -62,7 +88,12 @@ private:
 			, body(NULL)
 			, end(NULL)
 			, retVal(NULL)
-			, continue_(NULL) {}
+			, unwindDest(NULL)
+			, diScope(NULL)
+			, continue_(NULL)
+			, break_(NULL)
+			, params()
+			, instrumentRecord(-1) {}
 	};
 
 	std::deque<Block> blocks;
@@ -74,7 +105,44 @@ private:
 	}
 	Block& getEnclosingLoopBlock();
 
+	llvm::AllocaInst *createEntryBlockAlloca(llvm::Type *type, const llvm::Twine& name);
+	llvm::AllocaInst *createLocalVariable(Symbol *symbol, llvm::Type *type, unsigned int argNo = 0);
+	llvm::BasicBlock *createBasicBlock(const llvm::Twine& name, llvm::Function *func);
+
+	// the values of the variables, the functions and the parameters, filled when they are defined
+	// so that no name has to be looked up (and the values don't even need names)
+	llvm::DenseMap<Symbol *, llvm::Value *> values_;
+	llvm::Value *getValue(Symbol *symbol);
+
+	// String and array values which are not owned by any variable yet
+	std::vector<std::pair<llvm::Value *, Type *> > temporaries_;
+
+	// local arrays whose elements are on the stack (VarSymbol::stackCapacity)
+	llvm::DenseSet<llvm::AllocaInst *> stackArrays_;
+
+	bool needsDestructor(Type *type);
+	void registerDestructed(llvm::AllocaInst *var, Type *type);
+	void registerTemporary(llvm::Value *value, Type *type);
+	bool takeTemporary(llvm::Value *value);
+	void generateTemporariesCleanup(size_t from = 0);
+
+	llvm::Value *getUnwindDest();
+	llvm::BasicBlock *generateCleanup(Block& block);
+	void generateUnwind(Block& outermost, bool passOutermost, llvm::BasicBlock *dest);
+
+	// for (counter = 0; counter < count; ++counter) emitted by beginCountedLoop and endCountedLoop
+	// (the counter has the same type as count)
+	class CountedLoop {
+	public:
+		llvm::PHINode *counter;
+		llvm::BasicBlock *cond;
+		llvm::BasicBlock *after;
+	};
+	CountedLoop beginCountedLoop(llvm::Value *count, const llvm::Twine& name);
+	void endCountedLoop(CountedLoop& loop);
+
 	int counter_;
+	int unwindCounter_;
 
 	// don't remove that! (you wrote this twice!)
 	std::string getUniqNumStr() {
@@ -86,8 +154,51 @@ private:
 
 	void registerRuntimeFunctions();
 
-	void generateFuncDecl(const std::string& name, Type *type);
-	void generateGlobalVarDecl(const std::string& name, Type *type, bool isExternal);
+	// debug information (with -g)
+	llvm::DIBuilder *diBuilder_;
+	llvm::DICompileUnit *diCompileUnit_;
+	std::string compilationDir_;
+	std::map<std::string, llvm::DIFile *> diFiles_;
+	std::map<std::string, llvm::DIType *> diTypes_;
+	llvm::DIFile *getDIFile(const std::string& name);
+	llvm::DIType *getDIType(Type *type);
+	llvm::DISubprogram *createDISubprogram(llvm::Function *func, const std::string& name,
+			Position pos, FuncType *type);
+	llvm::DIScope *getDIScope(const std::string& fileName);
+	void setDebugLocation(Position pos);
+	void declareVariable(llvm::AllocaInst *local, Symbol *symbol, unsigned int argNo);
+
+	// profile-guided optimization (--profile-generate and --profile-use)
+	// the counters are allocated in the order of the generation, so they are the same in the both modes
+	llvm::GlobalVariable *profileCounters_; // replaced by the array of the counters at the end
+	int profileCounterNum_;
+	std::vector<uint64_t> profile_;
+	// branches and switches with the counters of their successors (-1 for never)
+	std::vector<std::pair<llvm::TerminatorInst *, std::vector<int> > > profiledBranches_;
+	std::vector<std::pair<llvm::Function *, int> > profiledFunctions_;
+	std::vector<int> gosubCounters_;
+	int allocateProfileCounters(int num);
+	void generateProfileCount(int counter, llvm::Value *offset = NULL);
+	llvm::BranchInst *generateProfiledCondBr(llvm::Value *cond, llvm::BasicBlock *ifTrue, llvm::BasicBlock *ifFalse);
+	void readProfile();
+	void finishProfile();
+
+	// instrumentation of the functions and the subroutines (--instrument)
+	// each record is {calls, cycles, depth}; the outermost entry subtracts the cycle counter from cycles
+	// and the exit back to it adds the counter, so the recursive calls are measured once
+	// (the runtime adds the counter to the unfinished ones at exit)
+	llvm::GlobalVariable *instrumentRecords_; // replaced by the array of the records at the end
+	std::vector<std::string> instrumentNames_;
+	std::map<Symbol *, int> labelRecords_;
+	int createInstrumentRecord(const std::string& name);
+	llvm::Value *getInstrumentField(int record, int field);
+	void generateInstrumentEnter(int record);
+	void generateInstrumentExit(int record);
+	void finishInstrument();
+
+	llvm::Function *generateFuncDecl(const std::string& name, Type *type, bool isExternal);
+	llvm::GlobalVariable *generateGlobalVarDecl(const std::string& name, Type *type, bool isExternal);
+	llvm::AllocaInst *generateMainLocalDecl(Symbol *symbol);
 
 	llvm::Type *getLLVMType(Type *type);
 	llvm::FunctionType *getLLVMFuncType(FuncType *ft);
@@ -116,46 +227,77 @@ private:
 	void generateGosubStmt(GosubStmt *gs);
 	void generateLabelStmt(LabelStmt *ls);
 
+	// labels are basic blocks of PeryanMain, and gosub pushes the id of its return block
+	// to the stack of return addresses ($gosubStack) which the return statements pop
+	std::map<Symbol *, llvm::BasicBlock *> labelBlocks_;
+	std::vector<llvm::BasicBlock *> gosubReturns_;
+	llvm::BasicBlock *globalReturn_;
+	Type *gosubStackType_;
+	llvm::Value *gosubStack_;
+	llvm::Value *getGosubStack();
+	llvm::Constant *getEmptyArray(ArrayType *type);
+	llvm::BasicBlock *getGlobalReturn();
+	void generateGlobalReturn();
+
 	void generateNamespaceStmt(NamespaceStmt *ns);
 
 	llvm::Value *generateExpr(Expr *expr);
 	llvm::Value *generateIdentifier(Identifier *id);
 
 	llvm::Value *generateDerefExpr(DerefExpr *de);
+	// counters of repeat loops which are PHI nodes instead of variables
+	llvm::DenseMap<Symbol *, llvm::Value *> counterValues_;
 
 	llvm::Value *generateBinaryExpr(BinaryExpr *be);
+	void collectConcatenatedExprs(Expr *expr, std::vector<Expr *>& exprs);
+	llvm::Value *generateConcatenation(std::vector<Expr *>& exprs);
 	llvm::Value *generateUnaryExpr(UnaryExpr *ue);
 
 	llvm::Value *generateLabelLiteralExpr(Label *label);
 	llvm::Value *generateStrLiteralExpr(StrLiteralExpr *sle);
+	llvm::Constant *getStringLiteral(const std::string& str);
+	std::map<std::string, llvm::Constant *> stringLiterals_;
 	llvm::Value *generateIntLiteralExpr(IntLiteralExpr *ile);
 	llvm::Value *generateFloatLiteralExpr(FloatLiteralExpr *fle);
 	llvm::Value *generateCharLiteralExpr(CharLiteralExpr *cle);
 	llvm::Value *generateBoolLiteralExpr(BoolLiteralExpr *ble);
 	llvm::Value *generateArrayLiteralExpr(ArrayLiteralExpr *ale);
 
-	llvm::Value *generateFuncCallExpr(FuncCallExpr *fce);
+	llvm::Value *generateFuncCallExpr(FuncCallExpr *fce, bool isTail = false);
+	bool isTailCallable(FuncCallExpr *fce);
 	llvm::Value *generateConstructorExpr(ConstructorExpr *ce);
 	llvm::Value *generateSubscrExpr(SubscrExpr *se);
+	void generateRangeCheck(SubscrExpr *se, llvm::Value *array, llvm::Value *subscr);
+	// whether the range of the counter of the loop is in the range of the array (for LOOP_CHECKED subscripts)
+	std::map<std::pair<RepeatStmt *, Symbol *>, llvm::Value *> loopRangeChecks_;
 	llvm::Value *generateMemberExpr(MemberExpr *me);
 
 
 	void generateConstructor(llvm::Value *dest, Type *type, Expr *init);
 	void generatePrimitiveTypeConstructor(llvm::Value *dest, Type *type, Expr *init);
 	void generateStringConstructor(llvm::Value *dest, Type *type, Expr *init);
-	void generateArrayConstructor(llvm::Value *dest, Type *type, Expr *init);
-	void generateArrayResize(llvm::Value *array, llvm::Value *size,
-			bool checkLength = true, bool runConstructor = true);
-
-	llvm::Value *lookup(const std::string& str);
+	void generateArrayConstructor(llvm::Value *dest, Type *type, Expr *init, llvm::Value *storage = NULL);
+	void generateArrayFill(llvm::Value *elements, llvm::Value *count,
+			llvm::Value *elementSize, llvm::Value *value, Type *type);
+	bool isPrimitiveType(Type *type);
+	unsigned int getPrimitiveTypeAlignment(Type *type);
+	bool isLiteralExpr(Expr *expr);
+	bool isVariableRead(Expr *expr);
+	llvm::Value *generateArrayMethodCall(FuncCallExpr *fce);
+	void generateArrayResize(llvm::Value *array, llvm::Value *size, Type *elemType);
+
+	llvm::Value *generateOwnedExpr(Expr *expr);
+	llvm::Value *generateCopy(llvm::Value *value, Type *type);
+	void generateDestructor(llvm::Value *value, Type *type, bool freesElements = true);
 public:
 	static void installStackTracer() {
 		llvm::sys::PrintStackTraceOnErrorSignal();
 		return;
 	}
 
-	Impl(Parser& parser, const std::string& fileName)
+	Impl(Parser& parser, Options& options, const std::string& fileName)
 		: parser_(parser)
+		, options_(options)
 		, fileName_(fileName)
 		, context_(llvm::getGlobalContext())
 		, builder_(context_)
@@ -168,19 +310,50 @@ public:
 		, Bool_		(parser_.getSymbolTable().Bool_)
 		, Label_	(parser_.getSymbolTable().Label_)
 		, Void_		(parser_.getSymbolTable().Void_)
+		, Int64_	(parser_.getSymbolTable().Int64_)
 		, blocks()
+		, values_()
+		, temporaries_()
+		, stackArrays_()
 		, counter_(0)
+		, unwindCounter_(0)
+		, diBuilder_(NULL)
+		, diCompileUnit_(NULL)
+		, compilationDir_()
+		, diFiles_()
+		, diTypes_()
+		, profileCounters_(NULL)
+		, profileCounterNum_(0)
+		, profile_()
+		, profiledBranches_()
+		, profiledFunctions_()
+		, gosubCounters_()
+		, instrumentRecords_(NULL)
+		, instrumentNames_()
+		, labelRecords_()
+		, labelBlocks_()
+		, gosubReturns_()
+		, globalReturn_(NULL)
+		, gosubStackType_(NULL)
+		, gosubStack_(NULL)
+		, stringLiterals_()
+		, loopRangeChecks_()
 	        {
 			llvm::InitializeNativeTarget();
 		}
 
+	~Impl() {
+		delete diBuilder_;
+		diBuilder_ = NULL;
+	}
+
 	void generate();
 };
 
 // begin pImpl pointer holder class
 
-LLVMCodeGen::LLVMCodeGen(Parser& parser, const std::string& fileName)
-	: impl_(new Impl(parser, fileName)) {}
+LLVMCodeGen::LLVMCodeGen(Parser& parser, Options& options, const std::string& fileName)
+	: impl_(new Impl(parser, options, fileName)) {}
 
 
 void LLVMCodeGen::generate() { impl_->generate(); return; }
@@ -201,7 +374,7 @@ void LLVMCodeGen::Impl::registerRuntimeFunctions() {
 
 	{
 		std::vector<llvm::Type *> paramTypes;
-		paramTypes.push_back(llvm::Type::getInt32Ty(context_));
+		paramTypes.push_back(llvm::Type::getInt64Ty(context_));
 
 		llvm::FunctionType *funcType =
 			llvm::FunctionType::get(llvm::Type::getInt8Ty(context_)->getPointerTo(), paramTypes, false);
@@ -222,7 +395,7 @@ void LLVMCodeGen::Impl::registerRuntimeFunctions() {
 	{
 		std::vector<llvm::Type *> paramTypes;
 		paramTypes.push_back(llvm::Type::getInt8Ty(context_)->getPointerTo());
-		paramTypes.push_back(llvm::Type::getInt32Ty(context_));
+		paramTypes.push_back(llvm::Type::getInt64Ty(context_));
 
 		llvm::FunctionType *funcType =
 			llvm::FunctionType::get(llvm::Type::getInt8Ty(context_)->getPointerTo(), paramTypes, false);
@@ -242,12 +415,96 @@ void LLVMCodeGen::Impl::registerRuntimeFunctions() {
 		llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "PRStringConstructorCStr", &module_);
 	}
 
-	generateFuncDecl("PRStringConstructorInt", new FuncType(Int_, String_));
-	generateFuncDecl("PRStringConstructorVoid", new FuncType(Void_, String_));
-	generateFuncDecl("PRStringConcatenate", new FuncType(String_, new FuncType(String_, String_)));
-	generateFuncDecl("PRStringDestructor", new FuncType(String_, Void_));
-	generateFuncDecl("PRStringCompare", new FuncType(String_, new FuncType(String_, Int_)));
-	generateFuncDecl("PRStringLength", new FuncType(String_, Int_));
+	{
+		std::vector<llvm::Type *> paramTypes;
+		paramTypes.push_back(getLLVMType(String_)->getPointerTo());
+		paramTypes.push_back(getLLVMType(String_));
+
+		llvm::FunctionType *funcType =
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), paramTypes, false);
+
+		llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "PRStringAppend", &module_);
+	}
+
+	{
+		std::vector<llvm::Type *> paramTypes;
+		paramTypes.push_back(llvm::Type::getInt32Ty(context_));
+		paramTypes.push_back(getLLVMType(String_)->getPointerTo());
+
+		llvm::FunctionType *funcType =
+			llvm::FunctionType::get(getLLVMType(String_), paramTypes, false);
+
+		llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "PRStringConcatenateN", &module_);
+	}
+
+	// for builtin arrays (struct Array * is passed as char*)
+
+	{
+		llvm::Type *charPtr = llvm::Type::getInt8Ty(context_)->getPointerTo();
+		llvm::Type *int32 = llvm::Type::getInt32Ty(context_);
+		llvm::Type *int64 = llvm::Type::getInt64Ty(context_);
+
+		std::vector<llvm::Type *> arrayParamTypes;
+		arrayParamTypes.push_back(charPtr);
+
+		// lengths and indices of arrays are 64-bit
+		std::vector<llvm::Type *> arrayIntParamTypes;
+		arrayIntParamTypes.push_back(charPtr);
+		arrayIntParamTypes.push_back(int64);
+
+		llvm::Function::Create(
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), arrayIntParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayReserve", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(int64, arrayIntParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayResize", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(charPtr, arrayIntParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayElement", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(charPtr, arrayParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayPush", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(charPtr, arrayParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayPop", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(charPtr, arrayIntParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayInsert", &module_);
+		llvm::Function::Create(
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), arrayIntParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRArrayRemove", &module_);
+
+		llvm::Function *outOfRange = llvm::Function::Create(
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), std::vector<llvm::Type *>(), false),
+			llvm::Function::ExternalLinkage, "PRArrayIndexOutOfRange", &module_);
+		outOfRange->setDoesNotReturn();
+
+		std::vector<llvm::Type *> profileParamTypes;
+		profileParamTypes.push_back(llvm::Type::getInt64PtrTy(context_));
+		profileParamTypes.push_back(int32);
+
+		llvm::Function::Create(
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), profileParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRProfileRegister", &module_);
+
+		std::vector<llvm::Type *> instrumentParamTypes;
+		instrumentParamTypes.push_back(llvm::Type::getInt64PtrTy(context_));
+		instrumentParamTypes.push_back(charPtr->getPointerTo());
+		instrumentParamTypes.push_back(int32);
+
+		llvm::Function::Create(
+			llvm::FunctionType::get(llvm::Type::getVoidTy(context_), instrumentParamTypes, false),
+			llvm::Function::ExternalLinkage, "PRInstrumentRegister", &module_);
+	}
+
+	generateFuncDecl("PRStringConstructorInt", new FuncType(Int_, String_), true);
+	generateFuncDecl("PRStringConstructorInt64", new FuncType(Int64_, String_), true);
+	generateFuncDecl("PRIntConstructor", new FuncType(String_, Int_), true);
+	generateFuncDecl("PRStringConstructorVoid", new FuncType(Void_, String_), true);
+	generateFuncDecl("PRStringConcatenate", new FuncType(String_, new FuncType(String_, String_)), true);
+	generateFuncDecl("PRStringDestructor", new FuncType(String_, Void_), true);
+	generateFuncDecl("PRStringCompare", new FuncType(String_, new FuncType(String_, Int_)), true);
+	generateFuncDecl("PRStringLength", new FuncType(String_, Int_), true);
 	
 	return;
 }
@@ -255,15 +512,50 @@ void LLVMCodeGen::Impl::registerRuntimeFunctions() {
 void LLVMCodeGen::Impl::generate() {
 	registerRuntimeFunctions();
 
+	if (options_.debugInfo) {
+		llvm::SmallString<256> cwd;
+		llvm::sys::fs::current_path(cwd);
+		compilationDir_.assign(cwd.begin(), cwd.end());
+
+		module_.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+		module_.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+
+		diBuilder_ = new llvm::DIBuilder(module_);
+		diCompileUnit_ = diBuilder_->createCompileUnit(llvm::dwarf::DW_LANG_C,
+				options_.mainFileName, compilationDir_, "Peryan Compiler", options_.optLevel > 0, "", 0);
+	}
+
+	if (options_.profileGenerate) {
+		profileCounters_ = new llvm::GlobalVariable(module_, llvm::Type::getInt64Ty(context_), false,
+				llvm::GlobalVariable::ExternalLinkage, NULL, "PRProfileCounters");
+	}
+	if (!options_.profileUse.empty())
+		readProfile();
+	if (options_.instrument) {
+		instrumentRecords_ = new llvm::GlobalVariable(module_, llvm::Type::getInt64Ty(context_), false,
+				llvm::GlobalVariable::ExternalLinkage, NULL, "PRInstrumentRecords");
+	}
+
 	generateTransUnit(parser_.getTransUnit());
 
 	assert(blocks.empty());
 
+	finishProfile();
+	finishInstrument();
+
+	if (diBuilder_ != NULL)
+		diBuilder_->finalize();
+
+	// the optimizer needs to know the target to vectorize the loops
+	module_.setTargetTriple(llvm::sys::getDefaultTargetTriple());
+
 	// This may help for fixing it: https://github.com/numba/llvmlite/issues/5
 	llvm::legacy::PassManager pm;
 	std::error_code error;
 	llvm::raw_fd_ostream rawStream(fileName_.c_str(), error, llvm::sys::fs::F_None);
 
+	// remove the functions and the variables which are never used (e.g. in peryandefs)
+	pm.add(llvm::createGlobalDCEPass());
 	pm.add(createPrintModulePass(rawStream));
 	pm.run(module_);
 
@@ -272,6 +564,337 @@ void LLVMCodeGen::Impl::generate() {
 	return;
 }
 
+llvm::DIFile *LLVMCodeGen::Impl::getDIFile(const std::string& name) {
+	std::map<std::string, llvm::DIFile *>::iterator found = diFiles_.find(name);
+	if (found != diFiles_.end())
+		return found->second;
+
+	return diFiles_[name] = diBuilder_->createFile(name, compilationDir_);
+}
+
+// String and arrays are shown as opaque values
+// the types are created once for each name since the types of arrays are not unique
+llvm::DIType *LLVMCodeGen::Impl::getDIType(Type *type) {
+	const std::string name = (type->isRef() ? "ref " : "") + type->unmodify()->getTypeName();
+	std::map<std::string, llvm::DIType *>::iterator found = diTypes_.find(name);
+	if (found != diTypes_.end())
+		return found->second;
+
+	llvm::DIType *res = NULL;
+	if (type->isRef()) {
+		res = diBuilder_->createReferenceType(llvm::dwarf::DW_TAG_reference_type,
+				getDIType(type->unmodify()));
+		return diTypes_[name] = res;
+	}
+
+	type = type->unmodify();
+
+	     if (type->is(Int_))	res = diBuilder_->createBasicType("Int", 32, 32, llvm::dwarf::DW_ATE_signed);
+	else if (type->is(Int64_))	res = diBuilder_->createBasicType("Int64", 64, 64, llvm::dwarf::DW_ATE_signed);
+	else if (type->is(Char_))	res = diBuilder_->createBasicType("Char", 8, 8, llvm::dwarf::DW_ATE_signed_char);
+	else if (type->is(Float_))	res = diBuilder_->createBasicType("Float", 32, 32, llvm::dwarf::DW_ATE_float);
+	else if (type->is(Double_))	res = diBuilder_->createBasicType("Double", 64, 64, llvm::dwarf::DW_ATE_float);
+	else if (type->is(Bool_))	res = diBuilder_->createBasicType("Bool", 8, 8, llvm::dwarf::DW_ATE_boolean);
+	else if (type->is(String_)) {
+		res = diBuilder_->createPointerType(diBuilder_->createUnspecifiedType("String"),
+				module_.getDataLayout().getPointerSizeInBits());
+	} else {
+		res = diBuilder_->createUnspecifiedType(type->getTypeName());
+	}
+
+	return diTypes_[name] = res;
+}
+
+// the subprogram of the function defined at pos (PeryanMain is at the top of the main source)
+llvm::DISubprogram *LLVMCodeGen::Impl::createDISubprogram(llvm::Function *func, const std::string& name,
+		Position pos, FuncType *type) {
+	std::string fileName = options_.mainFileName;
+	int line = 1, column = 1;
+	if (pos >= 0)
+		parser_.getLexer().getSourceLocation(pos, fileName, line, column);
+
+	// the return type, then the parameter types
+	std::vector<llvm::Metadata *> types;
+	if (type == NULL || type->getReturnType()->is(Void_)) {
+		types.push_back(NULL);
+	} else {
+		types.push_back(getDIType(type->getReturnType()));
+	}
+	if (type != NULL) {
+		for (FuncType::iterator it = type->begin(Void_); it != type->end(); ++it) {
+			types.push_back(getDIType(*it));
+		}
+	}
+
+	llvm::DIFile *file = getDIFile(fileName);
+	llvm::DISubprogram *subprogram = diBuilder_->createFunction(file, name, func->getName(), file, line,
+			diBuilder_->createSubroutineType(diBuilder_->getOrCreateTypeArray(types)),
+			func->hasInternalLinkage(), true, line, 0, options_.optLevel > 0);
+	func->setSubprogram(subprogram);
+
+	return subprogram;
+}
+
+// the scope of the enclosing function for the code in the file
+// (PeryanMain also contains the code of the imported files)
+llvm::DIScope *LLVMCodeGen::Impl::getDIScope(const std::string& fileName) {
+	llvm::DISubprogram *subprogram = getEnclosingFuncBlock().diScope;
+	llvm::DIFile *file = getDIFile(fileName);
+
+	if (subprogram->getFile() == file)
+		return subprogram;
+
+	return diBuilder_->createLexicalBlockFile(subprogram, file);
+}
+
+// the following instructions are at pos
+void LLVMCodeGen::Impl::setDebugLocation(Position pos) {
+	if (diBuilder_ == NULL)
+		return;
+
+	std::string fileName;
+	int line, column;
+	parser_.getLexer().getSourceLocation(pos, fileName, line, column);
+
+	builder_.SetCurrentDebugLocation(llvm::DILocation::get(context_, line, column, getDIScope(fileName)));
+	return;
+}
+
+void LLVMCodeGen::Impl::declareVariable(llvm::AllocaInst *local, Symbol *symbol, unsigned int argNo) {
+	std::string fileName;
+	int line, column;
+	parser_.getLexer().getSourceLocation(symbol->getPosition(), fileName, line, column);
+
+	llvm::DIScope *scope = getDIScope(fileName);
+
+	llvm::DILocalVariable *variable = NULL;
+	if (argNo > 0) {
+		variable = diBuilder_->createParameterVariable(scope, symbol->getSymbolName(), argNo,
+				getDIFile(fileName), line, getDIType(symbol->getType()));
+	} else {
+		variable = diBuilder_->createAutoVariable(scope, symbol->getSymbolName(),
+				getDIFile(fileName), line, getDIType(symbol->getType()));
+	}
+
+	// right after the allocation in the entry block
+	llvm::DILocation *location = llvm::DILocation::get(context_, line, column, scope);
+	if (local->getNextNode() != NULL) {
+		diBuilder_->insertDeclare(local, variable, diBuilder_->createExpression(), location,
+				local->getNextNode());
+	} else {
+		diBuilder_->insertDeclare(local, variable, diBuilder_->createExpression(), location,
+				local->getParent());
+	}
+
+	return;
+}
+
+// returns the first one of num new counters
+int LLVMCodeGen::Impl::allocateProfileCounters(int num) {
+	const int first = profileCounterNum_;
+	profileCounterNum_ += num;
+	return first;
+}
+
+// increment the counter (+ offset) at the insert point with --profile-generate
+void LLVMCodeGen::Impl::generateProfileCount(int counter, llvm::Value *offset) {
+	if (!options_.profileGenerate)
+		return;
+
+	llvm::Value *index = llvm::ConstantInt::get(getLLVMType(Int_), counter);
+	if (offset != NULL)
+		index = builder_.CreateAdd(index, offset);
+
+	llvm::Value *count = builder_.CreateGEP(profileCounters_, index);
+	builder_.CreateStore(builder_.CreateAdd(builder_.CreateLoad(count),
+				llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 1)), count);
+	return;
+}
+
+// conditional branch counting how many times each successor is taken
+llvm::BranchInst *LLVMCodeGen::Impl::generateProfiledCondBr(llvm::Value *cond,
+		llvm::BasicBlock *ifTrue, llvm::BasicBlock *ifFalse) {
+	const int counter = allocateProfileCounters(2);
+
+	if (options_.profileGenerate) {
+		generateProfileCount(counter, builder_.CreateSelect(cond,
+					llvm::ConstantInt::get(getLLVMType(Int_), 0),
+					llvm::ConstantInt::get(getLLVMType(Int_), 1)));
+	}
+
+	llvm::BranchInst *br = builder_.CreateCondBr(cond, ifTrue, ifFalse);
+
+	if (!profile_.empty()) {
+		std::vector<int> counters;
+		counters.push_back(counter);
+		counters.push_back(counter + 1);
+		profiledBranches_.push_back(std::make_pair(br, counters));
+	}
+
+	return br;
+}
+
+// the profile written by the runtime: the number of the counters, then the counts
+void LLVMCodeGen::Impl::readProfile() {
+	std::ifstream ifs(options_.profileUse.c_str());
+
+	int num = 0;
+	if (!(ifs>>num) || num < 0) {
+		std::cerr<<"warning: cannot read the profile "<<options_.profileUse<<std::endl;
+		return;
+	}
+
+	profile_.resize(num);
+	for (int i = 0; i < num; ++i) {
+		if (!(ifs>>profile_[i])) {
+			std::cerr<<"warning: cannot read the profile "<<options_.profileUse<<std::endl;
+			profile_.clear();
+			return;
+		}
+	}
+
+	return;
+}
+
+// allocate the counters and register them to the runtime (--profile-generate),
+// or attach the branch weights and the function entry counts (--profile-use)
+void LLVMCodeGen::Impl::finishProfile() {
+	if (options_.profileGenerate) {
+		llvm::ArrayType *countersType = llvm::ArrayType::get(llvm::Type::getInt64Ty(context_), profileCounterNum_);
+		llvm::GlobalVariable *counters = new llvm::GlobalVariable(module_, countersType, false,
+				llvm::GlobalVariable::InternalLinkage, llvm::ConstantAggregateZero::get(countersType));
+		profileCounters_->replaceAllUsesWith(
+				llvm::ConstantExpr::getBitCast(counters, profileCounters_->getType()));
+		counters->takeName(profileCounters_);
+		profileCounters_->eraseFromParent();
+		profileCounters_ = NULL;
+
+		llvm::BasicBlock& entry = module_.getFunction("PeryanMain")->getEntryBlock();
+		llvm::IRBuilder<> entryBuilder(&entry, entry.getFirstInsertionPt());
+
+		std::vector<llvm::Value *> args;
+		args.push_back(llvm::ConstantExpr::getBitCast(counters, llvm::Type::getInt64PtrTy(context_)));
+		args.push_back(llvm::ConstantInt::get(getLLVMType(Int_), profileCounterNum_));
+		entryBuilder.CreateCall(module_.getFunction("PRProfileRegister"), args);
+	}
+
+	if (options_.profileUse.empty() || profile_.empty())
+		return;
+
+	if (static_cast<int>(profile_.size()) != profileCounterNum_) {
+		std::cerr<<"warning: the profile "<<options_.profileUse<<" doesn't match the program"<<std::endl;
+		return;
+	}
+
+	// the weights are 32-bit
+	uint64_t maxCount = 0;
+	for (std::vector<uint64_t>::iterator it = profile_.begin(); it != profile_.end(); ++it) {
+		maxCount = std::max(maxCount, *it);
+	}
+	const uint64_t scale = maxCount / 0xffffffffULL + 1;
+
+	llvm::MDBuilder mdBuilder(context_);
+	for (std::vector<std::pair<llvm::TerminatorInst *, std::vector<int> > >::iterator it = profiledBranches_.begin();
+			it != profiledBranches_.end(); ++it) {
+		std::vector<uint32_t> weights;
+		for (std::vector<int>::iterator jt = it->second.begin(); jt != it->second.end(); ++jt) {
+			weights.push_back(*jt < 0 ? 0 : profile_[*jt] / scale);
+		}
+		it->first->setMetadata(llvm::LLVMContext::MD_prof, mdBuilder.createBranchWeights(weights));
+	}
+
+	for (std::vector<std::pair<llvm::Function *, int> >::iterator it = profiledFunctions_.begin();
+			it != profiledFunctions_.end(); ++it) {
+		it->first->setEntryCount(profile_[it->second]);
+	}
+
+	return;
+}
+
+int LLVMCodeGen::Impl::createInstrumentRecord(const std::string& name) {
+	instrumentNames_.push_back(name);
+	return instrumentNames_.size() - 1;
+}
+
+llvm::Value *LLVMCodeGen::Impl::getInstrumentField(int record, int field) {
+	return builder_.CreateGEP(instrumentRecords_,
+			llvm::ConstantInt::get(getLLVMType(Int_), record * 3 + field));
+}
+
+void LLVMCodeGen::Impl::generateInstrumentEnter(int record) {
+	llvm::Value *zero = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 0);
+	llvm::Value *one = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 1);
+	llvm::Value *now = builder_.CreateCall(
+			llvm::Intrinsic::getDeclaration(&module_, llvm::Intrinsic::readcyclecounter));
+
+	llvm::Value *calls = getInstrumentField(record, 0);
+	builder_.CreateStore(builder_.CreateAdd(builder_.CreateLoad(calls), one), calls);
+
+	llvm::Value *depth = getInstrumentField(record, 2);
+	llvm::Value *depthLoaded = builder_.CreateLoad(depth);
+	llvm::Value *cycles = getInstrumentField(record, 1);
+	builder_.CreateStore(builder_.CreateSub(builder_.CreateLoad(cycles),
+				builder_.CreateSelect(builder_.CreateICmpEQ(depthLoaded, zero), now, zero)), cycles);
+	builder_.CreateStore(builder_.CreateAdd(depthLoaded, one), depth);
+	return;
+}
+
+void LLVMCodeGen::Impl::generateInstrumentExit(int record) {
+	llvm::Value *zero = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 0);
+	llvm::Value *one = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 1);
+	llvm::Value *now = builder_.CreateCall(
+			llvm::Intrinsic::getDeclaration(&module_, llvm::Intrinsic::readcyclecounter));
+
+	llvm::Value *depth = getInstrumentField(record, 2);
+	llvm::Value *depthLoaded = builder_.CreateSub(builder_.CreateLoad(depth), one);
+	llvm::Value *cycles = getInstrumentField(record, 1);
+	builder_.CreateStore(builder_.CreateAdd(builder_.CreateLoad(cycles),
+				builder_.CreateSelect(builder_.CreateICmpEQ(depthLoaded, zero), now, zero)), cycles);
+	builder_.CreateStore(depthLoaded, depth);
+	return;
+}
+
+// allocate the records and register them with their names to the runtime
+void LLVMCodeGen::Impl::finishInstrument() {
+	if (!options_.instrument)
+		return;
+
+	llvm::Type *int64 = llvm::Type::getInt64Ty(context_);
+	llvm::Type *charPtr = llvm::Type::getInt8PtrTy(context_);
+
+	llvm::ArrayType *recordsType = llvm::ArrayType::get(int64, instrumentNames_.size() * 3);
+	llvm::GlobalVariable *records = new llvm::GlobalVariable(module_, recordsType, false,
+			llvm::GlobalVariable::InternalLinkage, llvm::ConstantAggregateZero::get(recordsType));
+	instrumentRecords_->replaceAllUsesWith(
+			llvm::ConstantExpr::getBitCast(records, instrumentRecords_->getType()));
+	records->takeName(instrumentRecords_);
+	instrumentRecords_->eraseFromParent();
+	instrumentRecords_ = NULL;
+
+	std::vector<llvm::Constant *> names;
+	for (std::vector<std::string>::iterator it = instrumentNames_.begin(); it != instrumentNames_.end(); ++it) {
+		llvm::Constant *name = llvm::ConstantDataArray::getString(context_, *it);
+		llvm::GlobalVariable *nameVar = new llvm::GlobalVariable(module_, name->getType(), true,
+				llvm::GlobalValue::PrivateLinkage, name);
+		names.push_back(llvm::ConstantExpr::getBitCast(nameVar, charPtr));
+	}
+
+	llvm::ArrayType *namesType = llvm::ArrayType::get(charPtr, names.size());
+	llvm::GlobalVariable *namesVar = new llvm::GlobalVariable(module_, namesType, true,
+			llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get(namesType, names));
+
+	llvm::BasicBlock& entry = module_.getFunction("PeryanMain")->getEntryBlock();
+	llvm::IRBuilder<> entryBuilder(&entry, entry.getFirstInsertionPt());
+
+	std::vector<llvm::Value *> args;
+	args.push_back(llvm::ConstantExpr::getBitCast(records, int64->getPointerTo()));
+	args.push_back(llvm::ConstantExpr::getBitCast(namesVar, charPtr->getPointerTo()));
+	args.push_back(llvm::ConstantInt::get(getLLVMType(Int_), names.size()));
+	entryBuilder.CreateCall(module_.getFunction("PRInstrumentRegister"), args);
+
+	return;
+}
+
 void LLVMCodeGen::Impl::generateGlobalDecl(Scope *scope) {
 	assert(scope != NULL);
 	// generate declaration of global functions and global variables
@@ -280,18 +903,23 @@ void LLVMCodeGen::Impl::generateGlobalDecl(Scope *scope) {
 		switch ((*it)->getSymbolType()) {
 		case Symbol::EXTERN_SYMBOL:
 			if ((*it)->getType()->unmodify()->getTypeType() == Type::FUNC_TYPE) {
-				generateFuncDecl((*it)->getSymbolName(), (*it)->getType());
+				values_[*it] = generateFuncDecl((*it)->getSymbolName(), (*it)->getType(), true);
 			} else {
-				generateGlobalVarDecl((*it)->getSymbolName(), (*it)->getType(), true);
+				values_[*it] = generateGlobalVarDecl((*it)->getSymbolName(), (*it)->getType(), true);
 			}
 			break;
 
 		case Symbol::FUNC_SYMBOL:
-			generateFuncDecl((*it)->getMangledSymbolName(), (*it)->getType());
+			if (!static_cast<FuncSymbol *>(*it)->isUnused)
+				values_[*it] = generateFuncDecl((*it)->getMangledSymbolName(), (*it)->getType(), false);
 			break;
 
 		case Symbol::VAR_SYMBOL:
-			generateGlobalVarDecl((*it)->getMangledSymbolName(), (*it)->getType(), false);
+			if (static_cast<VarSymbol *>(*it)->isMainLocal) {
+				generateMainLocalDecl(*it);
+			} else {
+				values_[*it] = generateGlobalVarDecl((*it)->getMangledSymbolName(), (*it)->getType(), false);
+			}
 			break;
 
 		case Symbol::BUILTIN_TYPE_SYMBOL:
@@ -306,7 +934,7 @@ void LLVMCodeGen::Impl::generateGlobalDecl(Scope *scope) {
 			break;
 
 		case Symbol::LABEL_SYMBOL:
-			generateFuncDecl((*it)->getMangledSymbolName(), (*it)->getType());
+			labelBlocks_[*it] = createBasicBlock("label" + getUniqNumStr(), getEnclosingFunc());
 			break;
 
 		default: ;
@@ -330,8 +958,11 @@ void LLVMCodeGen::Impl::generateTransUnit(TransUnit *tu) {
 		block.func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "PeryanMain", &module_);
 
 		const std::string curNumStr = getUniqNumStr();
-		block.body = llvm::BasicBlock::Create(context_, "globalBlockEntry" + curNumStr, block.func);
-		block.end = llvm::BasicBlock::Create(context_, "globalBlockEnd" + curNumStr, block.func);
+		block.body = createBasicBlock("globalBlockEntry" + curNumStr, block.func);
+		block.end = createBasicBlock("globalBlockEnd" + curNumStr, block.func);
+
+		if (diBuilder_ != NULL)
+			block.diScope = createDISubprogram(block.func, "PeryanMain", -1, NULL);
 
 		blocks.push_back(block);
 	}
@@ -341,6 +972,10 @@ void LLVMCodeGen::Impl::generateTransUnit(TransUnit *tu) {
 
 	builder_.SetInsertPoint(blocks.back().body);
 
+	const int mainRecord = options_.instrument ? createInstrumentRecord("(main)") : -1;
+	if (options_.instrument)
+		generateInstrumentEnter(mainRecord);
+
 	for (std::vector<Stmt *>::iterator it = tu->stmts.begin(); it != tu->stmts.end(); ++it) {
 		generateStmt(*it);
 	}
@@ -350,7 +985,12 @@ void LLVMCodeGen::Impl::generateTransUnit(TransUnit *tu) {
 	builder_.SetInsertPoint(blocks.back().body);
 	builder_.CreateBr(blocks.back().end);
 
-	builder_.SetInsertPoint(blocks.back().end);
+	if (globalReturn_ != NULL)
+		generateGlobalReturn();
+
+	builder_.SetInsertPoint(generateCleanup(blocks.back()));
+	if (options_.instrument)
+		generateInstrumentExit(mainRecord);
 	builder_.CreateRetVoid();
 
 	blocks.pop_back();
@@ -409,16 +1049,252 @@ LLVMCodeGen::Impl::Block& LLVMCodeGen::Impl::getEnclosingLoopBlock() {
 
 }
 
+// Allocates a local variable at the top of the entry block of the enclosing function,
+// so that it is allocated only once per call even in a loop and mem2reg can promote it.
+llvm::AllocaInst *LLVMCodeGen::Impl::createEntryBlockAlloca(llvm::Type *type, const llvm::Twine& name) {
+	llvm::BasicBlock& entry = getEnclosingFunc()->getEntryBlock();
+
+	llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+	return entryBuilder.CreateAlloca(type, 0, options_.discardNames ? llvm::Twine() : name);
+}
+
+// the local variable of the symbol (named by its mangled name unless --release)
+// (argNo is the position of the parameter from 1, or 0 for the other variables)
+llvm::AllocaInst *LLVMCodeGen::Impl::createLocalVariable(Symbol *symbol, llvm::Type *type, unsigned int argNo) {
+	llvm::AllocaInst *local = options_.discardNames ? createEntryBlockAlloca(type, llvm::Twine())
+				: createEntryBlockAlloca(type, symbol->getMangledSymbolName());
+	values_[symbol] = local;
+
+	if (diBuilder_ != NULL)
+		declareVariable(local, symbol, argNo);
+
+	return local;
+}
+
+// names only help to read the generated IR, so --release doesn't even build them
+llvm::BasicBlock *LLVMCodeGen::Impl::createBasicBlock(const llvm::Twine& name, llvm::Function *func) {
+	return llvm::BasicBlock::Create(context_, options_.discardNames ? llvm::Twine() : name, func);
+}
+
+llvm::Value *LLVMCodeGen::Impl::getValue(Symbol *symbol) {
+	llvm::DenseMap<Symbol *, llvm::Value *>::iterator it = values_.find(symbol);
+	assert(it != values_.end() && "the symbol is not defined yet");
+	return it->second;
+}
+
+// String and array own their memory unless they are references
+bool LLVMCodeGen::Impl::needsDestructor(Type *type) {
+	if (type->isRef())
+		return false;
+
+	type = type->unmodify();
+	return type->is(String_) || type->getTypeType() == Type::ARRAY_TYPE;
+}
+
+bool LLVMCodeGen::Impl::isPrimitiveType(Type *type) {
+	if (type->isRef())
+		return false;
+
+	type = type->unmodify();
+	return type->is(Int_) || type->is(Char_) || type->is(Bool_) || type->is(Float_) || type->is(Double_)
+		|| type->is(Int64_);
+}
+
+// the size of the primitive type is its alignment
+unsigned int LLVMCodeGen::Impl::getPrimitiveTypeAlignment(Type *type) {
+	assert(isPrimitiveType(type));
+
+	type = type->unmodify();
+	if (type->is(Char_) || type->is(Bool_))
+		return 1;
+	else if (type->is(Double_) || type->is(Int64_))
+		return 8;
+	else
+		return 4;
+}
+
+bool LLVMCodeGen::Impl::isLiteralExpr(Expr *expr) {
+	switch (expr->getASTType()) {
+	case AST::INT_LITERAL_EXPR:
+	case AST::FLOAT_LITERAL_EXPR:
+	case AST::CHAR_LITERAL_EXPR:
+	case AST::BOOL_LITERAL_EXPR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// reading a variable has no side effects
+bool LLVMCodeGen::Impl::isVariableRead(Expr *expr) {
+	if (expr->getASTType() != AST::DEREF_EXPR)
+		return false;
+
+	Expr *derefered = static_cast<DerefExpr *>(expr)->derefered;
+	return derefered->getASTType() == AST::IDENTIFIER || derefered->getASTType() == AST::STATIC_MEMBER_EXPR;
+}
+
+// the variable is destructed at the end of the current block.
+// the end block can be reached before the variable is constructed (ex. break before the definition),
+// so it is nulled at the function entry and after every destruction.
+void LLVMCodeGen::Impl::registerDestructed(llvm::AllocaInst *var, Type *type) {
+	assert(needsDestructor(type));
+
+	llvm::BasicBlock::iterator next = var->getIterator();
+	++next;
+	llvm::IRBuilder<> entryBuilder(var->getParent(), next);
+	entryBuilder.CreateStore(llvm::Constant::getNullValue(var->getAllocatedType()), var);
+
+	blocks.back().destructed.push_back(std::make_pair(var, type));
+	return;
+}
+
+// the value is destructed at the end of the statement unless its ownership is taken
+void LLVMCodeGen::Impl::registerTemporary(llvm::Value *value, Type *type) {
+	if (needsDestructor(type))
+		temporaries_.push_back(std::make_pair(value, type));
+	return;
+}
+
+bool LLVMCodeGen::Impl::takeTemporary(llvm::Value *value) {
+	for (int i = temporaries_.size() - 1; i >= 0; --i) {
+		if (temporaries_[i].first == value) {
+			temporaries_.erase(temporaries_.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// destruct the temporaries registered after the from-th one
+void LLVMCodeGen::Impl::generateTemporariesCleanup(size_t from) {
+	if (temporaries_.size() <= from)
+		return;
+
+	builder_.SetInsertPoint(blocks.back().body);
+	while (temporaries_.size() > from) {
+		generateDestructor(temporaries_.back().first, temporaries_.back().second);
+		temporaries_.pop_back();
+	}
+	blocks.back().body = builder_.GetInsertBlock();
+
+	return;
+}
+
+llvm::Value *LLVMCodeGen::Impl::getUnwindDest() {
+	Block& funcBlock = getEnclosingFuncBlock();
+	if (funcBlock.unwindDest == NULL)
+		funcBlock.unwindDest = createEntryBlockAlloca(getLLVMType(Int_), "$unwindDest");
+
+	return funcBlock.unwindDest;
+}
+
+// destruct the variables at the end block of the block, then forward the jumps passing it.
+// returns the basic block where the normal control flow continues.
+llvm::BasicBlock *LLVMCodeGen::Impl::generateCleanup(Block& block) {
+	builder_.SetInsertPoint(block.end);
+
+	for (std::vector<std::pair<llvm::AllocaInst *, Type *> >::reverse_iterator it = block.destructed.rbegin();
+			it != block.destructed.rend(); ++it) {
+		generateDestructor(builder_.CreateLoad(it->first), it->second, !stackArrays_.count(it->first));
+		builder_.CreateStore(llvm::Constant::getNullValue(it->first->getAllocatedType()), it->first);
+	}
+
+	if (block.unwinds.empty())
+		return builder_.GetInsertBlock();
+
+	llvm::BasicBlock *cleanupAfter = createBasicBlock("cleanupAfter" + getUniqNumStr(), getEnclosingFunc());
+
+	llvm::SwitchInst *si = builder_.CreateSwitch(builder_.CreateLoad(getUnwindDest()),
+						cleanupAfter, block.unwinds.size());
+	for (std::vector<std::pair<int, llvm::BasicBlock *> >::iterator it = block.unwinds.begin();
+			it != block.unwinds.end(); ++it) {
+		si->addCase(llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_), it->first), it->second);
+	}
+
+	builder_.SetInsertPoint(cleanupAfter);
+	return cleanupAfter;
+}
+
+// jump to dest through the end blocks which have something to destruct,
+// from the innermost block to outermost (outermost itself is passed only if passOutermost).
+// each end block finds the next destination with the id stored in $unwindDest.
+void LLVMCodeGen::Impl::generateUnwind(Block& outermost, bool passOutermost, llvm::BasicBlock *dest) {
+	std::vector<Block *> passed;
+	for (std::deque<Block>::reverse_iterator it = blocks.rbegin(); it != blocks.rend(); ++it) {
+		if (&(*it) == &outermost && !passOutermost)
+			break;
+		if (!(*it).destructed.empty())
+			passed.push_back(&(*it));
+		if (&(*it) == &outermost)
+			break;
+	}
+
+	builder_.SetInsertPoint(blocks.back().body);
+
+	if (passed.empty()) {
+		builder_.CreateBr(dest);
+		return;
+	}
+
+	const int id = ++unwindCounter_;
+	builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), id), getUnwindDest());
+	builder_.CreateBr(passed.front()->end);
+
+	for (int i = 0, iEnd = passed.size(); i < iEnd; ++i) {
+		llvm::BasicBlock *next = (i + 1 < iEnd) ? passed[i + 1]->end : dest;
+		passed[i]->unwinds.push_back(std::make_pair(id, next));
+	}
+
+	return;
+}
+
+// the builder is left in the loop body
+LLVMCodeGen::Impl::CountedLoop LLVMCodeGen::Impl::beginCountedLoop(llvm::Value *count, const llvm::Twine& name) {
+	CountedLoop loop;
+
+	llvm::Function *func = getEnclosingFunc();
+	llvm::BasicBlock *pre = builder_.GetInsertBlock();
+	loop.cond = createBasicBlock(name + "Cond", func);
+	llvm::BasicBlock *body = createBasicBlock(name + "Body", func);
+	loop.after = createBasicBlock(name + "After", func);
+
+	builder_.CreateBr(loop.cond);
+
+	builder_.SetInsertPoint(loop.cond);
+	loop.counter = builder_.CreatePHI(count->getType(), 2);
+	loop.counter->addIncoming(llvm::ConstantInt::get(count->getType(), 0), pre);
+	builder_.CreateCondBr(builder_.CreateICmpSLT(loop.counter, count), body, loop.after);
+
+	builder_.SetInsertPoint(body);
+	return loop;
+}
+
+// the builder is left in the block after the loop
+void LLVMCodeGen::Impl::endCountedLoop(CountedLoop& loop) {
+	llvm::Value *next = builder_.CreateNSWAdd(loop.counter, llvm::ConstantInt::get(loop.counter->getType(), 1));
+	loop.counter->addIncoming(next, builder_.GetInsertBlock());
+	builder_.CreateBr(loop.cond);
+
+	builder_.SetInsertPoint(loop.after);
+	return;
+}
+
 void LLVMCodeGen::Impl::generateStmt(Stmt *stmt) {
 	assert(stmt != NULL);
 
+	const size_t temporariesBegin = temporaries_.size();
+
+	setDebugLocation(stmt->token.getPosition());
+
 	switch (stmt->getASTType()) {
 	case AST::COMP_STMT	:
 		generateCompStmt(static_cast<CompStmt *>(stmt), true);
 		break;
 	case AST::FUNC_DEF_STMT	:
 		assert(isFunctionalGlobal() && "function definition should be global[stub]");
-		generateFuncDefStmt(static_cast<FuncDefStmt *>(stmt));
+		if (!static_cast<FuncDefStmt *>(stmt)->symbol->isUnused)
+			generateFuncDefStmt(static_cast<FuncDefStmt *>(stmt));
 		break;
 	case AST::VAR_DEF_STMT	:
 		generateVarDefStmt(static_cast<VarDefStmt *>(stmt));
@@ -471,6 +1347,9 @@ void LLVMCodeGen::Impl::generateStmt(Stmt *stmt) {
 		break;
 	default: assert(false && "unknown statement");
 	}
+
+	generateTemporariesCleanup(temporariesBegin);
+
 	return;
 }
 
@@ -484,8 +1363,8 @@ llvm::Type *LLVMCodeGen::Impl::getLLVMType(Type *type) {
 
 	if (type->getTypeType() == Type::ARRAY_TYPE) {
 		return llvm::StructType::get(
-				llvm::Type::getInt32Ty(context_), // int length
-				llvm::Type::getInt32Ty(context_), // int capacity
+				llvm::Type::getInt64Ty(context_), // long long length
+				llvm::Type::getInt64Ty(context_), // long long capacity
 				llvm::Type::getInt32Ty(context_), // int elementSize
 				getLLVMType(
 					/* be careful! : recursively calling getLLVMType */
@@ -495,6 +1374,7 @@ llvm::Type *LLVMCodeGen::Impl::getLLVMType(Type *type) {
 	} else if (type->getTypeType() == Type::BUILTIN_TYPE) {
 
 		     if (type->is(Int_))	return llvm::Type::getInt32Ty(context_);
+		else if (type->is(Int64_))	return llvm::Type::getInt64Ty(context_);
 		else if (type->is(String_))	return llvm::StructType::get(context_)->getPointerTo();
 						// opaque*
 
@@ -523,23 +1403,20 @@ llvm::FunctionType *LLVMCodeGen::Impl::getLLVMFuncType(FuncType *ft) {
 	return llvm::FunctionType::get(getLLVMType(ft->getReturnType()), paramTypes, false);
 }
 
-void LLVMCodeGen::Impl::generateFuncDecl(const std::string& name, Type *type) {
+// only the externs are visible from the outside of the module,
+// so that the optimizer can inline or remove the others freely
+llvm::Function *LLVMCodeGen::Impl::generateFuncDecl(const std::string& name, Type *type, bool isExternal) {
+	const llvm::Function::LinkageTypes linkage =
+		isExternal ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage;
 
-	if (type->unmodify()->getTypeType() == Type::FUNC_TYPE) {
-		llvm::Function::Create(
-			getLLVMFuncType(static_cast<FuncType *>(type)),
-			llvm::Function::ExternalLinkage, name, &module_);
-	} else if (type->is(Label_)) {
-		llvm::Function::Create(getLLVMFuncType(new FuncType(Void_, Void_)),
-			llvm::Function::ExternalLinkage, name, &module_);
-	} else {
-		assert(false);
-	}
+	assert(type->unmodify()->getTypeType() == Type::FUNC_TYPE);
 
-	return;
+	return llvm::Function::Create(
+			getLLVMFuncType(static_cast<FuncType *>(type)),
+			linkage, name, &module_);
 }
 
-void LLVMCodeGen::Impl::generateGlobalVarDecl(const std::string& name, Type *type, bool isExternal) {
+llvm::GlobalVariable *LLVMCodeGen::Impl::generateGlobalVarDecl(const std::string& name, Type *type, bool isExternal) {
 	assert(type->unmodify()->getTypeType() == Type::BUILTIN_TYPE
 		|| type->unmodify()->getTypeType() == Type::ARRAY_TYPE); // class not implemented
 
@@ -548,7 +1425,7 @@ void LLVMCodeGen::Impl::generateGlobalVarDecl(const std::string& name, Type *typ
 		if (type->isRef()) {
 			init = llvm::ConstantPointerNull::get(getLLVMType(type->unmodify())->getPointerTo());
 		} else if (type->unmodify()->is(Int_) || type->unmodify()->is(Char_)
-				|| type->unmodify()->is(Bool_)) {
+				|| type->unmodify()->is(Bool_) || type->unmodify()->is(Int64_)) {
 			// they will be initialized again, it is just to avoid LLVM IR syntax error
 			init = llvm::ConstantInt::get(getLLVMType(type), 0);
 		} else if (type->unmodify()->is(Float_) || type->unmodify()->is(Double_)) {
@@ -559,50 +1436,45 @@ void LLVMCodeGen::Impl::generateGlobalVarDecl(const std::string& name, Type *typ
 			init = llvm::ConstantPointerNull::get(
 				static_cast<llvm::PointerType *>(getLLVMType(String_)));
 		} else if (type->unmodify()->getTypeType() == Type::ARRAY_TYPE) {
-			// int length
-			// int capacity
-			// int elementSize
-			// Type* elements for [ Type ]
-
-			std::vector<llvm::Constant *> params;
-			params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-			params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-			params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-			params.push_back(llvm::ConstantPointerNull::get(
-				getLLVMType(static_cast<ArrayType *>(type->unmodify())->
-					getElemType())->getPointerTo()));
-
-			init = llvm::ConstantStruct::get(
-					static_cast<llvm::StructType *>(getLLVMType(type)), params);
+			init = getEmptyArray(static_cast<ArrayType *>(type->unmodify()));
 		} else {
 			std::cerr<<type->unmodify()->getTypeName()<<std::endl;
 			assert(false && "unknown type");
 		}
 	}
 
-	new llvm::GlobalVariable(module_, getLLVMType(type), false,
+	return new llvm::GlobalVariable(module_, getLLVMType(type), false,
 			(isExternal ? llvm::GlobalVariable::ExternalLinkage
-				    : llvm::GlobalVariable::CommonLinkage), init, name);
+				    : llvm::GlobalVariable::InternalLinkage), init, name);
+}
 
+// global variable which only the main function refers to is its local variable
+// (it is initialized like global variables, and destructed at the end of the program)
+llvm::AllocaInst *LLVMCodeGen::Impl::generateMainLocalDecl(Symbol *symbol) {
+	assert(isNamespaceGlobal());
 
-	return;
-}
+	Type *type = symbol->getType();
+	llvm::AllocaInst *local = createLocalVariable(symbol, getLLVMType(type));
+
+	if (needsDestructor(type)) {
+		registerDestructed(local, type);
+	} else {
+		builder_.SetInsertPoint(blocks.back().body);
+		builder_.CreateStore(llvm::Constant::getNullValue(local->getAllocatedType()), local);
+	}
 
-// if you implement C++ style cleanup, the overview is like that:
-// (1) make sure which statements cause cleanup
-// (2) add cleanup block at the end of the compound / function statement
-//     with label variable to memorize destination after cleanup
-//  -  when it comes to these statements, register its destination to the label variable,
-// (3) and jump to the cleanup block
+	return local;
+}
 
-// to realize this:
-// - if you start scope, create body, end block and destination variable for each
-// - if you constructed a variable add cleanup instructions at the proper end (= back().end)
-// - if you came across jump statement,
-//   - find out which end block you have to pass, ex. end5 end4 end3
-//   - register next destination to block: end5: -> end4, end4: -> end3, end3: -> returnStmtBlock
-// - if you ended scope,
-//   - add switch and jump statement by registration table
+// C++ style cleanup is done like that:
+// - each scope (compound, repeat, function) has its end block,
+//   and the variables constructed in the scope are registered to it (Block::destructed)
+// - jump statements (break, continue, return) store its id to the destination variable ($unwindDest)
+//   and jump to the innermost end block they have to pass, ex. end5 end4 end3
+// - the next destination is registered to each block (Block::unwinds):
+//   end5: -> end4, end4: -> end3, end3: -> returnStmtBlock
+// - if the scope ended, its end block destructs the variables,
+//   then switches by the registration table (generateCleanup)
 
 // isSimple means the CompStmt is not right after function feclaration
 // so if it is a simple block, we need to add new block
@@ -615,9 +1487,9 @@ void LLVMCodeGen::Impl::generateCompStmt(CompStmt *cs, bool isSimple, bool autoC
 
 
 		llvm::Function *func = getEnclosingFunc();
-		block.body = llvm::BasicBlock::Create(context_, "compBlockEntry" + curNumStr, func);
+		block.body = createBasicBlock("compBlockEntry" + curNumStr, func);
 		block.head = block.body;
-		block.end = llvm::BasicBlock::Create(context_, "compBlockEnd" + curNumStr, func);
+		block.end = createBasicBlock("compBlockEnd" + curNumStr, func);
 
 		if (autoConnect) {
 			// greater block's body -> the block's entry
@@ -637,18 +1509,20 @@ void LLVMCodeGen::Impl::generateCompStmt(CompStmt *cs, bool isSimple, bool autoC
 
 		// the block's body -> the block's end
 		builder_.SetInsertPoint(blocks.back().body);
+		if (!blocks.back().unwinds.empty())
+			builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), 0), getUnwindDest());
 		builder_.CreateBr(blocks.back().end);
 
 		compBlock = blocks.back();
+		compBlock.end = generateCleanup(blocks.back());
 
 		// the block's end -> greater block's new body
-		builder_.SetInsertPoint(blocks.back().end);
+		builder_.SetInsertPoint(compBlock.end);
 		blocks.pop_back();
 
 		if (autoConnect) {
 			llvm::Function *func = getEnclosingFunc();
-			blocks.back().body = llvm::BasicBlock::Create(context_, "compBlockAfter" + curNumStr,
-								func);
+			blocks.back().body = createBasicBlock("compBlockAfter" + curNumStr, func);
 			builder_.CreateBr(blocks.back().body);
 		}
 	}
@@ -671,21 +1545,39 @@ void LLVMCodeGen::Impl::generateFuncDefStmt(FuncDefStmt *fds) {
 	{
 		Block block(Block::FUNC_BLOCK);
 
-		block.func = module_.getFunction(fds->symbol->getMangledSymbolName());
-		assert(block.func != NULL);
+		block.func = static_cast<llvm::Function *>(getValue(fds->symbol));
+
+		block.body = createBasicBlock("funcBlockEntry" + curNumStr, block.func);
+		block.end = createBasicBlock("funcBlockEnd" + curNumStr, block.func);
+
+		if (diBuilder_ != NULL) {
+			block.diScope = createDISubprogram(block.func, fds->symbol->getSymbolName(),
+					fds->token.getPosition(), static_cast<FuncType *>(fds->symbol->getType()));
+		}
 
-		block.body = llvm::BasicBlock::Create(context_, "funcBlockEntry" + curNumStr, block.func);
-		block.end = llvm::BasicBlock::Create(context_, "funcBlockEnd" + curNumStr, block.func);
+		blocks.push_back(block);
+		setDebugLocation(fds->token.getPosition());
 
 		if (!(retType->is(Void_))) {
 			// allocate a variable in the stack frame to memorize return value
-			builder_.SetInsertPoint(block.body);
-			block.retVal = builder_.CreateAlloca(getLLVMType(retType), 0, "$retVal");
+			blocks.back().retVal = createEntryBlockAlloca(getLLVMType(retType), "$retVal");
 		}
+	}
 
-		blocks.push_back(block);
+	// count the calls of the function
+	{
+		const int counter = allocateProfileCounters(1);
+		builder_.SetInsertPoint(blocks.back().body);
+		generateProfileCount(counter);
+		if (!profile_.empty())
+			profiledFunctions_.push_back(std::make_pair(blocks.back().func, counter));
 	}
 
+	const int record = options_.instrument ? createInstrumentRecord(fds->symbol->getSymbolName()) : -1;
+	if (options_.instrument)
+		generateInstrumentEnter(record);
+	blocks.back().instrumentRecord = record;
+
 	// initialization of parameters
 
 	llvm::Function::arg_iterator llvmItr = blocks.back().func->arg_begin(),
@@ -693,33 +1585,40 @@ void LLVMCodeGen::Impl::generateFuncDefStmt(FuncDefStmt *fds) {
 	std::vector<Identifier *>::iterator idItr = fds->params.begin(),
 					 idItrEnd = fds->params.end();
 
-	for (; llvmItr != llvmItrEnd && idItr != idItrEnd; ++llvmItr, ++idItr) {
+	for (unsigned int argNo = 1; llvmItr != llvmItrEnd && idItr != idItrEnd; ++llvmItr, ++idItr, ++argNo) {
 		Type *curType = (*idItr)->type;
 
-		// TODO: you have to run copy constructor there!
-
 		assert(curType->getTypeType() == Type::BUILTIN_TYPE
 			|| curType->getTypeType() == Type::MODIFIER_TYPE); // class not yet supported
 
-		const std::string name = (*idItr)->symbol->getMangledSymbolName();
-		const std::string originalName =
-			(*idItr)->symbol->getMangledSymbolName() + std::string(".original");
+		if (!options_.discardNames)
+			(*llvmItr).setName((*idItr)->symbol->getMangledSymbolName() + std::string(".original"));
 
-		(*llvmItr).setName(originalName);
+		llvm::AllocaInst *allocaInst = createLocalVariable((*idItr)->symbol, getLLVMType(curType), argNo);
 
-		builder_.SetInsertPoint(blocks.back().body);
+		llvm::Value *from = &(*llvmItr);
 
-		llvm::AllocaInst *allocaInst  = builder_.CreateAlloca(
-				getLLVMType(curType), 0, name);
+		builder_.SetInsertPoint(blocks.back().body);
 
-		llvm::Value *from = lookup(originalName);
-		assert(from != NULL);
+		// the parameters are owned by the callee
+		if (needsDestructor(curType)) {
+			from = generateCopy(from, curType);
+			blocks.back().body = builder_.GetInsertBlock();
+			registerDestructed(allocaInst, curType);
+		}
 
 		builder_.CreateStore(from, allocaInst);
+		blocks.back().params.push_back(allocaInst);
 	}
 
 	assert(idItr == idItrEnd && llvmItr == llvmItrEnd);
 
+	// self tail calls jump to the head with the new parameters
+	blocks.back().head = createBasicBlock("funcBlockHead" + curNumStr, blocks.back().func);
+	builder_.SetInsertPoint(blocks.back().body);
+	builder_.CreateBr(blocks.back().head);
+	blocks.back().body = blocks.back().head;
+
 	generateCompStmt(fds->body, false);
 
 	assert(blocks.back().type == Block::FUNC_BLOCK);
@@ -727,7 +1626,11 @@ void LLVMCodeGen::Impl::generateFuncDefStmt(FuncDefStmt *fds) {
 	builder_.SetInsertPoint(blocks.back().body);
 	builder_.CreateBr(blocks.back().end);
 
-	builder_.SetInsertPoint(blocks.back().end);
+	// return statements don't register the unwinds to the function block since they all reach its end
+	assert(blocks.back().unwinds.empty());
+	builder_.SetInsertPoint(generateCleanup(blocks.back()));
+	if (options_.instrument)
+		generateInstrumentExit(record);
 	if (!(retType->is(Void_))) {
 		llvm::Value *retValLoaded = builder_.CreateLoad(blocks.back().retVal);
 		builder_.CreateRet(retValLoaded);
@@ -737,6 +1640,10 @@ void LLVMCodeGen::Impl::generateFuncDefStmt(FuncDefStmt *fds) {
 
 	blocks.pop_back();
 
+	// the location is in the scope of the function
+	if (diBuilder_ != NULL)
+		builder_.SetCurrentDebugLocation(llvm::DebugLoc());
+
 	return;
 }
 
@@ -768,6 +1675,14 @@ llvm::Value *LLVMCodeGen::Impl::generateExpr(Expr *expr) {
 llvm::Value *LLVMCodeGen::Impl::generateDerefExpr(DerefExpr *de) {
 	assert(de != NULL);
 
+	// the counter of the loop which is not modified is not in the memory
+	if (de->derefered->getASTType() == AST::IDENTIFIER) {
+		llvm::DenseMap<Symbol *, llvm::Value *>::iterator it =
+			counterValues_.find(static_cast<Identifier *>(de->derefered)->symbol);
+		if (it != counterValues_.end())
+			return it->second;
+	}
+
 	llvm::Value *derefered = generateExpr(de->derefered);
 	// TODO: make it another function
 	builder_.SetInsertPoint(blocks.back().body);
@@ -778,13 +1693,7 @@ llvm::Value *LLVMCodeGen::Impl::generateDerefExpr(DerefExpr *de) {
 llvm::Value *LLVMCodeGen::Impl::generateIdentifier(Identifier *id) {
 	assert(id->symbol->getType()->getTypeType() != Type::FUNC_TYPE);
 
-	llvm::Value *from = NULL;
-	if (id->symbol->getSymbolType() == Symbol::EXTERN_SYMBOL) {
-		from = lookup(id->symbol->getSymbolName());
-	} else {
-		from = lookup(id->symbol->getMangledSymbolName());
-	}
-	assert(from != NULL);
+	llvm::Value *from = getValue(id->symbol);
 
 	if (id->symbol->getType()->isRef()) {
 		builder_.SetInsertPoint(blocks.back().body);
@@ -795,6 +1704,76 @@ llvm::Value *LLVMCodeGen::Impl::generateIdentifier(Identifier *id) {
 }
 
 
+// instructions for the binary operators which are selected by binaryInsts
+typedef enum {
+	INST_NONE,
+	INST_XOR, INST_OR, INST_AND,
+	INST_ICMP_EQ, INST_ICMP_NE, INST_ICMP_SLT, INST_ICMP_SLE, INST_ICMP_SGT, INST_ICMP_SGE,
+	INST_FCMP_OEQ, INST_FCMP_ONE, INST_FCMP_OLT, INST_FCMP_OLE, INST_FCMP_OGT, INST_FCMP_OGE,
+	INST_SHL, INST_LSHR,
+	INST_ADD, INST_SUB, INST_MUL, INST_SDIV, INST_SREM,
+	INST_FADD, INST_FSUB, INST_FMUL, INST_FDIV,
+	INST_STR_EQ, INST_STR_NE, INST_STR_CONCAT
+} BinaryInst;
+
+// binaryInsts[type of the operands][operator] (indexed by Type::BuiltInId and Token::BinaryOp)
+static const BinaryInst binaryInsts[Type::BUILTIN_ID_NUM][Token::BINARY_OP_NUM] = {
+	/* Bool */
+	{ INST_XOR, INST_OR, INST_AND,
+	  INST_ICMP_EQ, INST_ICMP_NE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE, INST_NONE },
+	/* Char */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_ICMP_EQ, INST_ICMP_NE,
+	  INST_ICMP_SLT, INST_ICMP_SLE, INST_ICMP_SGT, INST_ICMP_SGE,
+	  INST_SHL, INST_LSHR,
+	  INST_ADD, INST_SUB, INST_MUL, INST_SDIV, INST_SREM },
+	/* Int */
+	{ INST_XOR, INST_OR, INST_AND,
+	  INST_ICMP_EQ, INST_ICMP_NE,
+	  INST_ICMP_SLT, INST_ICMP_SLE, INST_ICMP_SGT, INST_ICMP_SGE,
+	  INST_SHL, INST_LSHR,
+	  INST_ADD, INST_SUB, INST_MUL, INST_SDIV, INST_SREM },
+	/* Float */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_FCMP_OEQ, INST_FCMP_ONE,
+	  INST_FCMP_OLT, INST_FCMP_OLE, INST_FCMP_OGT, INST_FCMP_OGE,
+	  INST_NONE, INST_NONE,
+	  INST_FADD, INST_FSUB, INST_FMUL, INST_FDIV, INST_NONE },
+	/* Double */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_FCMP_OEQ, INST_FCMP_ONE,
+	  INST_FCMP_OLT, INST_FCMP_OLE, INST_FCMP_OGT, INST_FCMP_OGE,
+	  INST_NONE, INST_NONE,
+	  INST_FADD, INST_FSUB, INST_FMUL, INST_FDIV, INST_NONE },
+	/* String */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_STR_EQ, INST_STR_NE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_STR_CONCAT, INST_NONE, INST_NONE, INST_NONE, INST_NONE },
+	/* Void */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE, INST_NONE },
+	/* Label */
+	{ INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE,
+	  INST_NONE, INST_NONE, INST_NONE, INST_NONE, INST_NONE },
+	/* Int64 */
+	{ INST_XOR, INST_OR, INST_AND,
+	  INST_ICMP_EQ, INST_ICMP_NE,
+	  INST_ICMP_SLT, INST_ICMP_SLE, INST_ICMP_SGT, INST_ICMP_SGE,
+	  INST_SHL, INST_LSHR,
+	  INST_ADD, INST_SUB, INST_MUL, INST_SDIV, INST_SREM }
+};
+
 llvm::Value *LLVMCodeGen::Impl::generateBinaryExpr(BinaryExpr *be) {
 	assert(be->lhs->type->is(be->rhs->type));
 
@@ -808,12 +1787,10 @@ llvm::Value *LLVMCodeGen::Impl::generateBinaryExpr(BinaryExpr *be) {
 		llvm::BasicBlock *logicLhs = blocks.back().body;
 
 		// block where you evaluate right hand side
-		llvm::BasicBlock *logicRhs = llvm::BasicBlock::Create(context_,
-							"logicRhs" + numStr, func);
+		llvm::BasicBlock *logicRhs = createBasicBlock("logicRhs" + numStr, func);
 
 		// block where you reach after the evaluation
-		llvm::BasicBlock *logicAfter = llvm::BasicBlock::Create(context_,
-							"logicAfter" + numStr, func);
+		llvm::BasicBlock *logicAfter = createBasicBlock("logicAfter" + numStr, func);
 
 		const bool isAnd = (be->token.getType() == Token::AMP);
 
@@ -832,7 +1809,9 @@ llvm::Value *LLVMCodeGen::Impl::generateBinaryExpr(BinaryExpr *be) {
 
 		builder_.SetInsertPoint(logicRhs);
 		blocks.back().body = logicRhs;
+		const size_t temporariesBegin = temporaries_.size();
 		llvm::Value *rhs = generateExpr(be->rhs);
+		generateTemporariesCleanup(temporariesBegin);
 
 		// current block might be changed after the evaluation
 		logicRhs = blocks.back().body;
@@ -849,151 +1828,156 @@ llvm::Value *LLVMCodeGen::Impl::generateBinaryExpr(BinaryExpr *be) {
 		return pn;
 	}
 
+	// chain of String + (a + b + c + ...) is fused into one concatenation
+	if (be->lhs->type->unmodify()->is(String_) && be->token.getType() == Token::PLUS) {
+		std::vector<Expr *> exprs;
+		collectConcatenatedExprs(be, exprs);
+		if (exprs.size() > 2)
+			return generateConcatenation(exprs);
+	}
+
 	llvm::Value *lhs = generateExpr(be->lhs);
 	llvm::Value *rhs = generateExpr(be->rhs);
 
 	builder_.SetInsertPoint(blocks.back().body);
 
-	// ^ | &
-	if (be->lhs->type->is(Bool_) || be->lhs->type->is(Int_)) {
-		switch (be->token.getType()) {
-		case Token::CARET: return builder_.CreateXor(lhs, rhs);
-		case Token::PIPE: return builder_.CreateOr(lhs, rhs);
-		case Token::AMP: return builder_.CreateAnd(lhs, rhs);
-		default: ;
-		}
-	}
-
-	// = == != !
-	if (be->lhs->type->is(Int_) || be->lhs->type->is(Char_) || be->lhs->type->is(Bool_)) {
-		switch (be->token.getType()) {
-		case Token::EQL:
-		case Token::EQEQ:
-			return builder_.CreateICmpEQ(lhs, rhs);
-		case Token::EXCLEQ:
-		case Token::EXCL:
-			return builder_.CreateICmpNE(lhs, rhs);
-		default: ;
-		}
-	}
-	if (be->lhs->type->is(Float_) || be->lhs->type->is(Double_)) {
-		switch (be->token.getType()) {
-		case Token::EQL:
-		case Token::EQEQ:
-			return builder_.CreateFCmpOEQ(lhs, rhs);
-		case Token::EXCLEQ:
-		case Token::EXCL:
-			return builder_.CreateFCmpONE(lhs, rhs);
-		default: ;
-		}
-	}
-	if (be->lhs->type->is(String_)) {
-		switch (be->token.getType()) {
-		case Token::EQL:
-		case Token::EQEQ:
-		case Token::EXCLEQ:
-		case Token::EXCL:
-			{
-				std::vector<llvm::Value *> params;
-				params.push_back(lhs);
-				params.push_back(rhs);
+	const Type::BuiltInId typeId = be->lhs->type->unmodify()->getBuiltInId();
+	const Token::BinaryOp op = Token::getBinaryOp(be->token.getType());
+	assert(typeId != Type::NOT_BUILTIN && op != Token::NOT_BINARY_OP);
+
+	switch (binaryInsts[typeId][op]) {
+	case INST_XOR	: return builder_.CreateXor(lhs, rhs);
+	case INST_OR	: return builder_.CreateOr(lhs, rhs);
+	case INST_AND	: return builder_.CreateAnd(lhs, rhs);
+
+	case INST_ICMP_EQ	: return builder_.CreateICmpEQ(lhs, rhs);
+	case INST_ICMP_NE	: return builder_.CreateICmpNE(lhs, rhs);
+	case INST_ICMP_SLT	: return builder_.CreateICmpSLT(lhs, rhs);
+	case INST_ICMP_SLE	: return builder_.CreateICmpSLE(lhs, rhs);
+	case INST_ICMP_SGT	: return builder_.CreateICmpSGT(lhs, rhs);
+	case INST_ICMP_SGE	: return builder_.CreateICmpSGE(lhs, rhs);
+
+	case INST_FCMP_OEQ	: return builder_.CreateFCmpOEQ(lhs, rhs);
+	case INST_FCMP_ONE	: return builder_.CreateFCmpONE(lhs, rhs);
+	case INST_FCMP_OLT	: return builder_.CreateFCmpOLT(lhs, rhs);
+	case INST_FCMP_OLE	: return builder_.CreateFCmpOLE(lhs, rhs);
+	case INST_FCMP_OGT	: return builder_.CreateFCmpOGT(lhs, rhs);
+	case INST_FCMP_OGE	: return builder_.CreateFCmpOGE(lhs, rhs);
+
+	case INST_SHL	: return builder_.CreateShl(lhs, rhs);
+	case INST_LSHR	: return builder_.CreateLShr(lhs, rhs);
+
+	case INST_ADD	: return builder_.CreateAdd(lhs, rhs);
+	case INST_SUB	: return builder_.CreateSub(lhs, rhs);
+	case INST_MUL	: return builder_.CreateMul(lhs, rhs);
+	case INST_SDIV	: return builder_.CreateSDiv(lhs, rhs);
+	case INST_SREM	: return builder_.CreateSRem(lhs, rhs);
+
+	case INST_FADD	: return builder_.CreateFAdd(lhs, rhs);
+	case INST_FSUB	: return builder_.CreateFSub(lhs, rhs);
+	case INST_FMUL	: return builder_.CreateFMul(lhs, rhs);
+	case INST_FDIV	: return builder_.CreateFDiv(lhs, rhs);
+
+	case INST_STR_EQ:
+	case INST_STR_NE:
+		{
+			std::vector<llvm::Value *> params;
+			params.push_back(lhs);
+			params.push_back(rhs);
 
-				llvm::Function *func = module_.getFunction("PRStringCompare");
-				assert(func != NULL);
+			llvm::Function *func = module_.getFunction("PRStringCompare");
+			assert(func != NULL);
 
-				llvm::Value *ret = builder_.CreateCall(func, params);
-				if (be->token.getType() == Token::EQL || be->token.getType() == Token::EQEQ) {
-					return builder_.CreateICmpEQ(ret, llvm::ConstantInt::get(getLLVMType(Int_), 0));
-				} else {
-					return builder_.CreateICmpNE(ret, llvm::ConstantInt::get(getLLVMType(Int_), 0));
-				}
+			llvm::Value *ret = builder_.CreateCall(func, params);
+			if (binaryInsts[typeId][op] == INST_STR_EQ) {
+				return builder_.CreateICmpEQ(ret, llvm::ConstantInt::get(getLLVMType(Int_), 0));
+			} else {
+				return builder_.CreateICmpNE(ret, llvm::ConstantInt::get(getLLVMType(Int_), 0));
 			}
-		default: ;
 		}
-	}
 
-	// < <= > >=
-	if (be->lhs->type->is(Int_) || be->lhs->type->is(Char_)) {
-		switch (be->token.getType()) {
-		case Token::LT	: return builder_.CreateICmpSLT(lhs, rhs);
-		case Token::LTEQ: return builder_.CreateICmpSLE(lhs, rhs);
-		case Token::GT	: return builder_.CreateICmpSGT(lhs, rhs);
-		case Token::GTEQ: return builder_.CreateICmpSGE(lhs, rhs);
-		default: ;
-		}
-	}
+	case INST_STR_CONCAT:
+		{
+			std::vector<llvm::Value *> params;
+			params.push_back(lhs);
+			params.push_back(rhs);
 
-	if (be->lhs->type->is(Float_) || be->lhs->type->is(Double_)) {
-		switch (be->token.getType()) {
-		case Token::LT	: return builder_.CreateFCmpOLT(lhs, rhs);
-		case Token::LTEQ: return builder_.CreateFCmpOLE(lhs, rhs);
-		case Token::GT	: return builder_.CreateFCmpOGT(lhs, rhs);
-		case Token::GTEQ: return builder_.CreateFCmpOGE(lhs, rhs);
-		default: ;
-		}
-	}
+			llvm::Function *func = module_.getFunction("PRStringConcatenate");
+			assert(func != NULL);
 
-	// << >>
-	if (be->lhs->type->is(Int_) || be->lhs->type->is(Char_)) {
-		switch (be->token.getType()) {
-		case Token::LTLT: return builder_.CreateShl(lhs, rhs);
-		case Token::GTGT: return builder_.CreateLShr(lhs, rhs);
-		default: ;
+			llvm::Value *res = builder_.CreateCall(func, params);
+			registerTemporary(res, String_);
+			return res;
 		}
+
+	case INST_NONE: ;
 	}
 
-	// + - * / (%)
-	if (be->lhs->type->is(Int_) || be->lhs->type->is(Char_)) {
-		switch (be->token.getType()) {
-		case Token::PLUS: return builder_.CreateAdd(lhs, rhs);
-		case Token::MINUS: return builder_.CreateSub(lhs, rhs);
-		case Token::STAR: return builder_.CreateMul(lhs, rhs);
-		case Token::SLASH: return builder_.CreateSDiv(lhs, rhs);
-		case Token::PERC: return builder_.CreateSRem(lhs, rhs);
-		default: ;
+	assert(false && "no matching binary expression operator");
+	return NULL;
+}
+
+void LLVMCodeGen::Impl::collectConcatenatedExprs(Expr *expr, std::vector<Expr *>& exprs) {
+	if (expr->getASTType() == AST::BINARY_EXPR) {
+		BinaryExpr *be = static_cast<BinaryExpr *>(expr);
+		if (be->lhs->type->unmodify()->is(String_) && be->token.getType() == Token::PLUS) {
+			collectConcatenatedExprs(be->lhs, exprs);
+			collectConcatenatedExprs(be->rhs, exprs);
+			return;
 		}
 	}
-	if (be->lhs->type->is(Float_) || be->lhs->type->is(Double_)) {
-		switch (be->token.getType()) {
-		case Token::PLUS: return builder_.CreateFAdd(lhs, rhs);
-		case Token::MINUS: return builder_.CreateFSub(lhs, rhs);
-		case Token::STAR: return builder_.CreateFMul(lhs, rhs);
-		case Token::SLASH: return builder_.CreateFDiv(lhs, rhs);
-		default: ;
-		}
+
+	exprs.push_back(expr);
+	return;
+}
+
+// PRStringConcatenateN(count, strs) with the array strs allocated in the stack frame
+llvm::Value *LLVMCodeGen::Impl::generateConcatenation(std::vector<Expr *>& exprs) {
+	std::vector<llvm::Value *> strs;
+	for (std::vector<Expr *>::iterator it = exprs.begin(); it != exprs.end(); ++it) {
+		strs.push_back(generateExpr(*it));
 	}
 
-	// + for String
-	if (be->lhs->type->unmodify()->is(String_) && be->token.getType() == Token::PLUS) {
-		std::vector<llvm::Value *> params;
-		params.push_back(lhs);
-		params.push_back(rhs);
+	llvm::Type *lvString = getLLVMType(String_);
+	llvm::Value *strsArray = createEntryBlockAlloca(llvm::ArrayType::get(lvString, strs.size()),
+							"concatenated" + getUniqNumStr());
 
-		llvm::Function *func = module_.getFunction("PRStringConcatenate");
-		assert(func != NULL);
+	builder_.SetInsertPoint(blocks.back().body);
 
-		builder_.SetInsertPoint(blocks.back().body);
-		return builder_.CreateCall(func, params);
+	llvm::Value *strsPtr = builder_.CreateBitCast(strsArray, lvString->getPointerTo());
+	for (int i = 0, iEnd = strs.size(); i < iEnd; ++i) {
+		builder_.CreateStore(strs[i],
+			builder_.CreateGEP(strsPtr, llvm::ConstantInt::get(getLLVMType(Int_), i)));
 	}
 
-	assert(false && "no matching binary expression operator");
-	return NULL;
+	std::vector<llvm::Value *> params;
+	params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), strs.size()));
+	params.push_back(strsPtr);
+
+	llvm::Function *func = module_.getFunction("PRStringConcatenateN");
+	assert(func != NULL);
+
+	llvm::Value *res = builder_.CreateCall(func, params);
+	registerTemporary(res, String_);
+	return res;
 }
 
 llvm::Value *LLVMCodeGen::Impl::generateUnaryExpr(UnaryExpr *ue) {
 	llvm::Value *rhs = generateExpr(ue->rhs);
 
 	if (ue->token.getType() == Token::PLUS) {
-		assert(ue->rhs->type->is(Int_) || ue->rhs->type->is(Char_)
+		assert(ue->rhs->type->is(Int_) || ue->rhs->type->is(Char_) || ue->rhs->type->is(Int64_)
 				|| ue->rhs->type->is(Float_) || ue->rhs->type->is(Double_));
 
 		return generateExpr(ue->rhs);
 	} else if (ue->token.getType() == Token::MINUS) {
 		assert(ue->rhs->type->unmodify()->is(Int_) || ue->rhs->type->unmodify()->is(Char_)
+				|| ue->rhs->type->unmodify()->is(Int64_)
 				|| ue->rhs->type->unmodify()->is(Float_) || ue->rhs->type->unmodify()->is(Double_));
 
 		builder_.SetInsertPoint(blocks.back().body);
-		if (ue->rhs->type->unmodify()->is(Int_) || ue->rhs->type->unmodify()->is(Char_)) {
+		if (ue->rhs->type->unmodify()->is(Int_) || ue->rhs->type->unmodify()->is(Char_)
+				|| ue->rhs->type->unmodify()->is(Int64_)) {
 			return builder_.CreateNeg(rhs);
 		} else if (ue->rhs->type->unmodify()->is(Float_) || ue->rhs->type->unmodify()->is(Double_)) {
 			return builder_.CreateFNeg(rhs);
@@ -1012,23 +1996,66 @@ llvm::Value *LLVMCodeGen::Impl::generateUnaryExpr(UnaryExpr *ue) {
 }
 
 llvm::Value *LLVMCodeGen::Impl::generateLabelLiteralExpr(Label *label) {
+	assert(labelBlocks_.count(label->symbol));
 
-	llvm::Value *found = lookup(label->symbol->getMangledSymbolName());
-	assert(found != NULL);
-
-	return found;
+	return llvm::BlockAddress::get(labelBlocks_[label->symbol]);
 }
 
+// String literal is not a temporary (copying it just increments its refCount)
 llvm::Value *LLVMCodeGen::Impl::generateStrLiteralExpr(StrLiteralExpr *sle) {
+	return getStringLiteral(sle->str);
+}
 
+// each String literal is a global struct String shared by the whole module.
+// it is immortal because its refCount starts from PR_STRING_IMMORTAL (runtime/layout.h),
+// so that the destructor never frees it and the runtime copies it before modifying.
+llvm::Constant *LLVMCodeGen::Impl::getStringLiteral(const std::string& str) {
+	std::map<std::string, llvm::Constant *>::iterator found = stringLiterals_.find(str);
+	if (found != stringLiterals_.end())
+		return found->second;
 
-	builder_.SetInsertPoint(blocks.back().body);
-	llvm::Value *dest = builder_.CreateAlloca(getLLVMType(sle->type), 0, "strLiteral" + getUniqNumStr());
+	const std::string curNumStr = getUniqNumStr();
 
-	generateConstructor(dest, sle->type, sle);
+	llvm::Type *lvInt = getLLVMType(Int_);
 
-	builder_.SetInsertPoint(blocks.back().body);
-	return builder_.CreateLoad(dest);
+	// characters (with terminating null character)
+	llvm::Constant *data = llvm::ConstantDataArray::getString(context_, str);
+	llvm::GlobalVariable *dataVar = new llvm::GlobalVariable(module_, data->getType(), true,
+				llvm::GlobalValue::PrivateLinkage, data, "strLiteralData" + curNumStr);
+
+	std::vector<llvm::Constant *> dataIndices;
+	dataIndices.push_back(llvm::ConstantInt::get(lvInt, 0));
+	dataIndices.push_back(llvm::ConstantInt::get(lvInt, 0));
+
+	// struct String in runtime/layout.h
+	// int refCount
+	// int length
+	// int capacity
+	// char *str
+	// char small[PR_STRING_SMALL_CAPACITY]
+	std::vector<llvm::Type *> memberTypes;
+	memberTypes.push_back(lvInt);
+	memberTypes.push_back(lvInt);
+	memberTypes.push_back(lvInt);
+	memberTypes.push_back(llvm::Type::getInt8Ty(context_)->getPointerTo());
+	memberTypes.push_back(llvm::ArrayType::get(llvm::Type::getInt8Ty(context_), PR_STRING_SMALL_CAPACITY));
+	llvm::StructType *headerType = llvm::StructType::get(context_, memberTypes);
+
+	std::vector<llvm::Constant *> members;
+	members.push_back(llvm::ConstantInt::get(lvInt, PR_STRING_IMMORTAL));
+	members.push_back(llvm::ConstantInt::get(lvInt, str.size()));
+	members.push_back(llvm::ConstantInt::get(lvInt, str.size() + 1));
+	members.push_back(llvm::ConstantExpr::getGetElementPtr(data->getType(), dataVar, dataIndices));
+	members.push_back(llvm::Constant::getNullValue(memberTypes[4]));
+
+	// it is not constant since refCount is modified
+	llvm::GlobalVariable *headerVar = new llvm::GlobalVariable(module_, headerType, false,
+				llvm::GlobalValue::PrivateLinkage, llvm::ConstantStruct::get(headerType, members),
+				"strLiteral" + curNumStr);
+
+	llvm::Constant *res = llvm::ConstantExpr::getBitCast(headerVar, getLLVMType(String_));
+	stringLiterals_[str] = res;
+	return res;
 }
 
 llvm::Value *LLVMCodeGen::Impl::generateIntLiteralExpr(IntLiteralExpr *ile) {
@@ -1052,7 +2079,37 @@ llvm::Value *LLVMCodeGen::Impl::generateArrayLiteralExpr(ArrayLiteralExpr *ale)
 	return NULL;
 }
 
-llvm::Value *LLVMCodeGen::Impl::generateFuncCallExpr(FuncCallExpr *fce) {
+// the call can be the last thing the function does:
+// nothing is destructed after it and it doesn't refer to the stack frame of the function
+bool LLVMCodeGen::Impl::isTailCallable(FuncCallExpr *fce) {
+	if (!temporaries_.empty())
+		return false;
+
+	for (std::deque<Block>::reverse_iterator it = blocks.rbegin(); it != blocks.rend(); ++it) {
+		if (!(*it).destructed.empty())
+			return false;
+		if ((*it).type == Block::FUNC_BLOCK)
+			break;
+	}
+
+	// the references must be the ones passed to the function or the global variables
+	for (std::vector<Expr *>::iterator it = fce->params.begin(); it != fce->params.end(); ++it) {
+		if (!(*it)->type->isRef())
+			continue;
+		if ((*it)->getASTType() != AST::IDENTIFIER)
+			return false;
+
+		Symbol *symbol = static_cast<Identifier *>(*it)->symbol;
+		if (!symbol->getType()->isRef() && !llvm::isa<llvm::GlobalVariable>(getValue(symbol)))
+			return false;
+	}
+
+	return true;
+}
+
+// if isTail, the call is generated as the return of the function and NULL is returned
+// unless it can't be a tail call (see isTailCallable)
+llvm::Value *LLVMCodeGen::Impl::generateFuncCallExpr(FuncCallExpr *fce, bool isTail) {
 
 	Symbol *symbol = NULL;
 
@@ -1062,8 +2119,10 @@ llvm::Value *LLVMCodeGen::Impl::generateFuncCallExpr(FuncCallExpr *fce) {
 	} else if (fce->func->getASTType() == AST::STATIC_MEMBER_EXPR) {
 		StaticMemberExpr *sme = static_cast<StaticMemberExpr *>(fce->func);
 		symbol = sme->member->symbol;
+	} else if (fce->func->getASTType() == AST::MEMBER_EXPR) {
+		return generateArrayMethodCall(fce);
 	} else {
-		assert(false && "member instruction not supported yet!");
+		assert(false && "function object not supported yet!");
 	}
 	assert(symbol != NULL);
 
@@ -1076,54 +2135,105 @@ llvm::Value *LLVMCodeGen::Impl::generateFuncCallExpr(FuncCallExpr *fce) {
 		ft = static_cast<FuncType *>(ft->getCdr());
 	}
 
-	std::string funcName;
-	if (symbol->getSymbolType() == Symbol::EXTERN_SYMBOL) {
-		funcName = symbol->getSymbolName();
-	} else {
-		funcName = symbol->getMangledSymbolName();
+	llvm::Value *func = getValue(symbol);
+
+	builder_.SetInsertPoint(blocks.back().body);
+
+	if (isTail && isTailCallable(fce)) {
+		Block& funcBlock = getEnclosingFuncBlock();
+
+		if (func == funcBlock.func) {
+			// self recursion is a loop
+			if (options_.instrument) {
+				llvm::Value *calls = getInstrumentField(funcBlock.instrumentRecord, 0);
+				builder_.CreateStore(builder_.CreateAdd(builder_.CreateLoad(calls),
+					llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), 1)), calls);
+			}
+
+			assert(params.size() == funcBlock.params.size());
+			for (size_t i = 0; i < params.size(); ++i)
+				builder_.CreateStore(params[i], funcBlock.params[i]);
+			builder_.CreateBr(funcBlock.head);
+		} else {
+			// the function exits before the call which replaces it
+			if (options_.instrument)
+				generateInstrumentExit(funcBlock.instrumentRecord);
+
+			// musttail guarantees that the stack doesn't grow but requires the same prototype
+			llvm::CallInst *call = builder_.CreateCall(func, params);
+			call->setTailCallKind(func->getType() == funcBlock.func->getType()
+						? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+			if (call->getType()->isVoidTy())
+				builder_.CreateRetVoid();
+			else
+				builder_.CreateRet(call);
+		}
+
+		blocks.back().body = createBasicBlock("tailCallAfter" + getUniqNumStr(), funcBlock.func);
+		return NULL;
 	}
 
-	llvm::Function *func = module_.getFunction(funcName);
-	assert(func != NULL);
+	llvm::Value *res = builder_.CreateCall(func, params);
 
-	builder_.SetInsertPoint(blocks.back().body);
-	return builder_.CreateCall(func, params);
+	// returned String and array are always newly constructed
+	if (fce->type != NULL)
+		registerTemporary(res, fce->type);
+	return res;
 }
 
 // generateConstructorExpr and generateConstructor are completely different!
 llvm::Value *LLVMCodeGen::Impl::generateConstructorExpr(ConstructorExpr *ce) {
 
-	builder_.SetInsertPoint(blocks.back().body);
-	llvm::Value *dest = builder_.CreateAlloca(getLLVMType(ce->type), 0, "constructed" + getUniqNumStr());
+	llvm::Value *dest = createEntryBlockAlloca(getLLVMType(ce->type), "constructed" + getUniqNumStr());
 
 	generateConstructor(dest, ce->type, ce);
 
 	builder_.SetInsertPoint(blocks.back().body);
-	return builder_.CreateLoad(dest);
+	llvm::Value *res = builder_.CreateLoad(dest);
+	registerTemporary(res, ce->type);
+	return res;
 }
 
 void LLVMCodeGen::Impl::generateVarDefStmt(VarDefStmt *vds) {
 	assert(vds != NULL);
 
+	Type *type = vds->symbol->getType();
+
 	llvm::Value *to = NULL;
+	llvm::AllocaInst *local = NULL;
 	if (isNamespaceGlobal()) {
-		to = lookup(vds->symbol->getMangledSymbolName());
+		to = getValue(vds->symbol);
+
+		// the definition runs again if a goto jumps back over it (the first time it is null or empty)
+		if (!labelBlocks_.empty() && needsDestructor(type)) {
+			builder_.SetInsertPoint(blocks.back().body);
+			generateDestructor(builder_.CreateLoad(to), type);
+		}
 	} else {
-		builder_.SetInsertPoint(blocks.back().body);
-		to = builder_.CreateAlloca(getLLVMType(vds->symbol->getType()), 0,
-									vds->symbol->getMangledSymbolName());
+		to = local = createLocalVariable(vds->symbol, getLLVMType(type));
 	}
-	assert(to != NULL);
 
-	generateConstructor(to, vds->symbol->getType(), vds->init);
+	const int stackCapacity = static_cast<VarSymbol *>(vds->symbol)->stackCapacity;
+	if (local != NULL && stackCapacity > 0) {
+		llvm::Type *lvElemType = getLLVMType(static_cast<ArrayType *>(type)->getElemType());
+		llvm::Value *storage = createEntryBlockAlloca(llvm::ArrayType::get(lvElemType, stackCapacity),
+								"stackElements" + getUniqNumStr());
+		stackArrays_.insert(local);
+		generateArrayConstructor(to, type, vds->init, storage);
+	} else {
+		generateConstructor(to, type, vds->init);
+	}
 
+	// global variables live until the end of the program
+	if (local != NULL && needsDestructor(type))
+		registerDestructed(local, type);
 
 	return;
 }
 
-// primitive type means one of these types: Int, Char, Bool, Float, Double, Label
+// primitive type means one of these types: Int, Int64, Char, Bool, Float, Double, Label
 void LLVMCodeGen::Impl::generatePrimitiveTypeConstructor(llvm::Value *dest, Type *type, Expr *init) {
-	assert(type->is(Int_) || type->is(Char_) || type->is(Bool_)
+	assert(type->is(Int_) || type->is(Char_) || type->is(Bool_) || type->is(Int64_)
 		|| type->is(Float_) || type->is(Double_) || type->is(Label_));
 	assert(!(type->is(Label_)));
 
@@ -1141,25 +2251,38 @@ void LLVMCodeGen::Impl::generatePrimitiveTypeConstructor(llvm::Value *dest, Type
 
 			Type *from = ce->params[0]->type->unmodify();
 			Type *to = ce->type;
-			if ((from->is(Bool_) || from->is(Char_) || from->is(Int_))
-				&& (to->is(Char_) || to->is(Int_))) {
+			if ((from->is(Bool_) || from->is(Char_) || from->is(Int_) || from->is(Int64_))
+				&& (to->is(Char_) || to->is(Int_) || to->is(Int64_))) {
 
-				// integer to integer
+				// integer to integer (Bool is unsigned)
 				builder_.SetInsertPoint(blocks.back().body);
-				src = builder_.CreateTrunc(prm, getLLVMType(to));
-			} else if ((from->is(Char_) || from->is(Int_)) && (to->is(Bool_))) {
+				if (from->is(Bool_))
+					src = builder_.CreateZExtOrTrunc(prm, getLLVMType(to));
+				else
+					src = builder_.CreateSExtOrTrunc(prm, getLLVMType(to));
+			} else if ((from->is(Char_) || from->is(Int_) || from->is(Int64_)) && (to->is(Bool_))) {
 				// integer to Bool (prm != 0 ? true : false)
 				builder_.SetInsertPoint(blocks.back().body);
 				src = builder_.CreateICmpNE(prm, llvm::ConstantInt::get(getLLVMType(from), 0));
 			} else if ((from->is(Float_) || from->is(Double_))
-					&& (to->is(Char_) || to->is(Int_))) {
+					&& (to->is(Char_) || to->is(Int_) || to->is(Int64_))) {
 				// real to integer
 				builder_.SetInsertPoint(blocks.back().body);
 				src = builder_.CreateFPToSI(prm, getLLVMType(to));
-			} else if ((from->is(Char_) || from->is(Int_) || from->is(Bool_))
+			} else if ((from->is(Char_) || from->is(Int_) || from->is(Bool_) || from->is(Int64_))
 					&& (to->is(Float_) || to->is(Double_))) {
 				// integer to real 
 				src = builder_.CreateSIToFP(prm, getLLVMType(to));
+			} else if (from->is(String_) && to->is(Int_)) {
+				// String to integer
+				std::vector<llvm::Value *> params;
+				params.push_back(prm);
+
+				llvm::Function *func = module_.getFunction("PRIntConstructor");
+				assert(func != NULL);
+
+				builder_.SetInsertPoint(blocks.back().body);
+				src = builder_.CreateCall(func, params);
 			} else {
 				assert(false && "no viable casting constructor");
 			}
@@ -1168,7 +2291,7 @@ void LLVMCodeGen::Impl::generatePrimitiveTypeConstructor(llvm::Value *dest, Type
 			src = generateExpr(init);
 		}
 	} else {
-		if (type->is(Int_) || type->is(Char_) || type->is(Bool_)) {
+		if (type->is(Int_) || type->is(Char_) || type->is(Bool_) || type->is(Int64_)) {
 			src = llvm::ConstantInt::get(getLLVMType(type), 0);
 		} else if (type->is(Float_) || type->is(Double_)) {
 			src = llvm::ConstantFP::get(getLLVMType(type), 0.0);
@@ -1192,27 +2315,22 @@ void LLVMCodeGen::Impl::generateStringConstructor(llvm::Value *dest, Type *type,
 	if (init != NULL && init->getASTType() == AST::STR_LITERAL_EXPR) {
 		StrLiteralExpr *sle = static_cast<StrLiteralExpr *>(init);
 
-		std::vector<llvm::Value *> params;
-		params.push_back(builder_.CreateGlobalStringPtr(sle->str));
-
-		llvm::Function *func = module_.getFunction("PRStringConstructorCStr");
-		assert(func != NULL);
-
 		builder_.SetInsertPoint(blocks.back().body);
 
-		llvm::Value *src = builder_.CreateCall(func, params);
+		llvm::Value *src = generateCopy(getStringLiteral(sle->str), String_);
 		builder_.CreateStore(src, dest);
 
 	// int to string constructor
 	} else if (init != NULL && init->getASTType() == AST::CONSTRUCTOR_EXPR) {
 		ConstructorExpr *ce = static_cast<ConstructorExpr *>(init);
 		assert(ce->params.size() == 1);
-		assert(ce->params[0]->type->unmodify()->is(Int_));
+		assert(ce->params[0]->type->unmodify()->is(Int_) || ce->params[0]->type->unmodify()->is(Int64_));
 
 		std::vector<llvm::Value *> params;
 		params.push_back(generateExpr(ce->params[0]));
 
-		llvm::Function *func = module_.getFunction("PRStringConstructorInt");
+		llvm::Function *func = module_.getFunction(ce->params[0]->type->unmodify()->is(Int64_)
+				? "PRStringConstructorInt64" : "PRStringConstructorInt");
 		assert(func != NULL);
 
 		builder_.SetInsertPoint(blocks.back().body);
@@ -1222,11 +2340,11 @@ void LLVMCodeGen::Impl::generateStringConstructor(llvm::Value *dest, Type *type,
 
 	// copy constructor
 	} else if (init != NULL) {
-		// TODO: in some case you have to run copy constructors there
 		assert(init->getASTType() != AST::CONSTRUCTOR_EXPR);
 
-		llvm::Value *src = generateExpr(init);
+		llvm::Value *src = generateOwnedExpr(init);
 
+		builder_.SetInsertPoint(blocks.back().body);
 		builder_.CreateStore(src, dest);
 
 	// normal constructor with no argument
@@ -1244,7 +2362,8 @@ void LLVMCodeGen::Impl::generateStringConstructor(llvm::Value *dest, Type *type,
 	return;
 }
 
-void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type, Expr *init) {
+// the elements are allocated in storage if it's not NULL (it must be large enough)
+void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type, Expr *init, llvm::Value *storage) {
 	assert(type->getTypeType() == Type::ARRAY_TYPE);
 
 	// TODO: the case wich doesn't match this will needs copy constructor
@@ -1258,9 +2377,9 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 		ConstructorExpr *ce = static_cast<ConstructorExpr *>(init);
 		if (ce->params.size() == 0) {
 		} else if (ce->params.size() == 1) {
-			assert(ce->params[0]->type->unmodify()->is(Int_));
+			assert(ce->params[0]->type->unmodify()->is(Int_) || ce->params[0]->type->unmodify()->is(Int64_));
 		} else if (ce->params.size() == 2){
-			assert(ce->params[0]->type->unmodify()->is(Int_));
+			assert(ce->params[0]->type->unmodify()->is(Int_) || ce->params[0]->type->unmodify()->is(Int64_));
 			assert(ce->params[1]->type->unmodify()->is(at->getElemType()->unmodify()));
 		} else {
 			assert(false && "unknown constructor parameters");
@@ -1270,8 +2389,8 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 
 	const int kArrayDefaultCapacity = 1;
 
-	// int length
-	// int capacity
+	// long long length
+	// long long capacity
 	// int elementSize
 	// Type* elements for [ Type ]
 
@@ -1279,10 +2398,10 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	// ; [Type]* is not valid LLVM type
 	//
 	// %length = getelementptr [Type]* %dest, i32 0, i32 0
-	// store i32 0, i32* %length
+	// store i64 0, i64* %length
 	//
 	// %capacity = getelementptr [Type]* %dest, i32 0, i32 1
-	// store i32 kArrayDefaultCapacity, i32* %capacity
+	// store i64 kArrayDefaultCapacity, i64* %capacity
 	//
 	// ; elementSize can be obtained from technique in the page:
 	// ; http://nondot.org/sabre/LLVMNotes/SizeOf-OffsetOf-VariableSizedStructs.txt
@@ -1292,9 +2411,9 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	// store i32 %elementSizeValue, i32* %elementSize
 	//
 	// %elements = getelementptr [Type]* %dest, i32 0, i32 3
-	// %capacityValue = load i32* %capacity
-	// %mallocedSize = mul i32 %capacityValue %elementSizeValue
-	// %malloced = call i8* @PRMalloc(i32 %mallocedSize)
+	// %capacityValue = load i64* %capacity
+	// %mallocedSize = mul i64 %capacityValue (zext %elementSizeValue)
+	// %malloced = call i8* @PRMalloc(i64 %mallocedSize)
 	// %castedMalloced = bitcast i8* %malloced to Type*
 	// store Type* %castedMalloced, Type** %elements
 	//
@@ -1303,11 +2422,12 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	builder_.SetInsertPoint(blocks.back().body);
 
 	llvm::Type *lvInt = getLLVMType(Int_);
+	llvm::Type *lvInt64 = getLLVMType(Int64_);
 	//llvm::Type *lvArrayType = getLLVMType(at);
 	llvm::Type *lvType = getLLVMType(at->getElemType());
 
 	// %length = getelementptr [Type]* %dest, i32 0, i32 0
-	// store i32 0, i32* %length
+	// store i64 0, i64* %length
 	std::vector<llvm::Value *> lengthParams;
 	lengthParams.push_back(llvm::ConstantInt::get(lvInt, 0));
 	lengthParams.push_back(llvm::ConstantInt::get(lvInt, 0));
@@ -1322,24 +2442,26 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	builder_.SetInsertPoint(blocks.back().body);
 	llvm::Value *lengthValOfCE = NULL;
 	if (init == NULL) {
-		builder_.CreateStore(llvm::ConstantInt::get(lvInt, 0), length);
-		// store i32 kArrayDefaultCapacity, i32* %capacity
-		builder_.CreateStore(llvm::ConstantInt::get(lvInt, kArrayDefaultCapacity), capacity);
+		builder_.CreateStore(llvm::ConstantInt::get(lvInt64, 0), length);
+		// store i64 kArrayDefaultCapacity, i64* %capacity
+		builder_.CreateStore(llvm::ConstantInt::get(lvInt64, kArrayDefaultCapacity), capacity);
 	} else if (init->getASTType() == AST::ARRAY_LITERAL_EXPR) {
 		const unsigned int aleLen = static_cast<ArrayLiteralExpr *>(init)->elements.size();
-		builder_.CreateStore(llvm::ConstantInt::get(lvInt, aleLen), length);
-		// store i32 ale->elements.size(), i32* %capacity
-		builder_.CreateStore(llvm::ConstantInt::get(lvInt, aleLen), capacity);
+		builder_.CreateStore(llvm::ConstantInt::get(lvInt64, aleLen), length);
+		// store i64 ale->elements.size(), i64* %capacity
+		builder_.CreateStore(llvm::ConstantInt::get(lvInt64, aleLen), capacity);
 	} else if (init->getASTType() == AST::CONSTRUCTOR_EXPR) {
 		ConstructorExpr *ce = static_cast<ConstructorExpr *>(init);
 		if (ce->params.size() > 0) {
+			// the length is Int or Int64
 			lengthValOfCE = generateExpr(ce->params[0]);
 			builder_.SetInsertPoint(blocks.back().body);
+			lengthValOfCE = builder_.CreateSExt(lengthValOfCE, lvInt64);
 			builder_.CreateStore(lengthValOfCE, length);
 			builder_.CreateStore(lengthValOfCE, capacity);
 		} else {
-			builder_.CreateStore(llvm::ConstantInt::get(lvInt, 0), length);
-			builder_.CreateStore(llvm::ConstantInt::get(lvInt, kArrayDefaultCapacity), capacity);
+			builder_.CreateStore(llvm::ConstantInt::get(lvInt64, 0), length);
+			builder_.CreateStore(llvm::ConstantInt::get(lvInt64, kArrayDefaultCapacity), capacity);
 		}
 	} else {
 		assert(false && "unknown array constructing expression");
@@ -1356,97 +2478,109 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	llvm::Value *elementSize = builder_.CreateGEP(dest, elementSizeParams);
 	llvm::Value *elementSizeTester = builder_.CreateGEP(
 			llvm::ConstantPointerNull::get(lvType->getPointerTo()),
-			llvm::ConstantInt::get(lvInt, 2));
+			llvm::ConstantInt::get(lvInt, 1));
 	llvm::Value *elementSizeValue = builder_.CreatePtrToInt(elementSizeTester, lvInt);
 	builder_.CreateStore(elementSizeValue, elementSize);
 
 	// %elements = getelementptr [Type]* %dest, i32 0, i32 3
-	// %capacityValue = load i32* %capacity
-	// %mallocedSize = mul i32 %capacityValue %elementSizeValue
-	// %malloced = call i8* @PRMalloc(i32 %mallocedSize)
+	// %capacityValue = load i64* %capacity
+	// %mallocedSize = mul i64 %capacityValue (zext %elementSizeValue)
+	// %malloced = call i8* @PRMalloc(i64 %mallocedSize)
 	// %castedMalloced = bitcast i8* %malloced to Type*
 	// store Type* %castedMalloced, Type** %elements
+	llvm::Value *elementSizeValue64 = builder_.CreateZExt(elementSizeValue, lvInt64);
 	std::vector<llvm::Value *> elementsParams;
 	elementsParams.push_back(llvm::ConstantInt::get(lvInt, 0));
 	elementsParams.push_back(llvm::ConstantInt::get(lvInt, 3));
 	llvm::Value *elements = builder_.CreateGEP(dest, elementsParams);
-	llvm::Value *capacityValue = builder_.CreateLoad(capacity);
-	llvm::Value *mallocedSize = builder_.CreateMul(capacityValue, elementSizeValue);
-	llvm::Value *malloced = builder_.CreateCall(lookup("PRMalloc"), mallocedSize);
+	llvm::Value *malloced = NULL;
+	if (storage != NULL) {
+		malloced = builder_.CreateBitCast(storage, llvm::Type::getInt8PtrTy(context_));
+	} else {
+		llvm::Value *capacityValue = builder_.CreateLoad(capacity);
+		llvm::Value *mallocedSize = builder_.CreateMul(capacityValue, elementSizeValue64);
+		malloced = builder_.CreateCall(module_.getFunction("PRMalloc"), mallocedSize);
+	}
 	llvm::Value *castedMalloced = builder_.CreateBitCast(malloced, lvType->getPointerTo());
 	builder_.CreateStore(castedMalloced, elements);
 
 	if (init != NULL && init->getASTType() == AST::ARRAY_LITERAL_EXPR) {
 		ArrayLiteralExpr *ale = static_cast<ArrayLiteralExpr *>(init);
 
-		for (int i = 0, iMax = ale->elements.size(); i < iMax; ++i) {
+		// the literal made of primitive literals is copied from a constant at once
+		std::vector<llvm::Constant *> constants;
+		if (isPrimitiveType(at->getElemType())) {
+			for (int i = 0, iMax = ale->elements.size(); i < iMax; ++i) {
+				llvm::Value *element = isLiteralExpr(ale->elements[i]) ? generateExpr(ale->elements[i]) : NULL;
+				if (element == NULL || !llvm::isa<llvm::Constant>(element))
+					break;
+				constants.push_back(llvm::cast<llvm::Constant>(element));
+			}
+		}
+
+		if (!constants.empty() && constants.size() == ale->elements.size()) {
+			llvm::ArrayType *lvArrayType = llvm::ArrayType::get(lvType, constants.size());
+			llvm::GlobalVariable *literal = new llvm::GlobalVariable(module_, lvArrayType, true,
+					llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get(lvArrayType, constants),
+					"arrayLiteral" + getUniqNumStr());
+
+			builder_.SetInsertPoint(blocks.back().body);
+			builder_.CreateMemCpy(malloced,
+				builder_.CreateBitCast(literal, llvm::Type::getInt8Ty(context_)->getPointerTo()),
+				builder_.CreateMul(llvm::ConstantInt::get(lvInt64, constants.size()), elementSizeValue64),
+				getPrimitiveTypeAlignment(at->getElemType()));
+		} else {
+			for (int i = 0, iMax = ale->elements.size(); i < iMax; ++i) {
 
-			// %initialized = getelementptr Type* %castedMalloced, i32 i
-			llvm::Value *initialized = builder_.CreateGEP(castedMalloced, llvm::ConstantInt::get(lvInt, i));
-			assert(at->getElemType()->is(ale->elements[i]->type));
-			generateConstructor(initialized, at->getElemType(), ale->elements[i]);
+				// %initialized = getelementptr Type* %castedMalloced, i32 i
+				builder_.SetInsertPoint(blocks.back().body);
+				llvm::Value *initialized = builder_.CreateGEP(castedMalloced, llvm::ConstantInt::get(lvInt, i));
+				assert(at->getElemType()->is(ale->elements[i]->type));
+				generateConstructor(initialized, at->getElemType(), ale->elements[i]);
+			}
 		}
 	} else if (init != NULL && init->getASTType() == AST::CONSTRUCTOR_EXPR) {
 		ConstructorExpr *ce = static_cast<ConstructorExpr *>(init);
 		if (ce->params.size() > 0) {
 			assert(lengthValOfCE != NULL);
 
-			// FIXME BUG AROUND THERE (Lengths.pr)
-
-			const std::string curNumStr = getUniqNumStr();
-
-			builder_.SetInsertPoint(blocks.back().body);
-			llvm::Value *counter = builder_.CreateAlloca(
-					getLLVMType(Int_), 0, "arrayLoopCounter" + curNumStr);
-			builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), 0), counter);
+			// primitive elements are filled at once if the initializer evaluates the same value every time
+			if (isPrimitiveType(at->getElemType())
+				&& (ce->params.size() == 1 || isLiteralExpr(ce->params[1]) || isVariableRead(ce->params[1]))) {
+				llvm::Value *value = NULL;
+				if (ce->params.size() == 1) {
+					value = llvm::Constant::getNullValue(lvType);
+				} else {
+					value = generateExpr(ce->params[1]);
+				}
 
-			// arrayLoopCond
-			llvm::Function *func = getEnclosingFunc();
-			llvm::BasicBlock *loopCond =
-				llvm::BasicBlock::Create(context_,
-						"arrayLoopCond" + curNumStr, func);
-			// arrayLoopBody
-			llvm::BasicBlock *loopBody =
-				llvm::BasicBlock::Create(context_,
-						"arrayLoopBody" + curNumStr, func);
-			// arrayLoopAfter
-			llvm::BasicBlock *loopAfter =
-				llvm::BasicBlock::Create(context_,
-						"arrayLoopAfter" + curNumStr, func);
+				builder_.SetInsertPoint(blocks.back().body);
+				generateArrayFill(castedMalloced, lengthValOfCE, elementSizeValue64, value, at->getElemType());
+				blocks.back().body = builder_.GetInsertBlock();
+			} else {
+				builder_.SetInsertPoint(blocks.back().body);
+				CountedLoop loop = beginCountedLoop(lengthValOfCE, "arrayLoop" + getUniqNumStr());
+				blocks.back().body = builder_.GetInsertBlock();
 
-			builder_.SetInsertPoint(blocks.back().body);
-			builder_.CreateBr(loopCond);
+				llvm::Value *initialized = builder_.CreateGEP(castedMalloced, loop.counter);
 
-			builder_.SetInsertPoint(loopCond);
-			// if (counter < lengthValOfCE) { goto arrayLoopBody } else { goto arrayLoopAfter }
-			builder_.CreateCondBr(
-				builder_.CreateICmpSLT(builder_.CreateLoad(counter), lengthValOfCE),
-				loopBody,
-				loopAfter);
+				const size_t temporariesBegin = temporaries_.size();
 
-			builder_.SetInsertPoint(loopBody);
-			blocks.back().body = loopBody;
+				if (ce->params.size() == 1) {
+					generateConstructor(initialized, at->getElemType(), NULL);
+				} else if (ce->params.size() == 2) {
+					generateConstructor(initialized, at->getElemType(), ce->params[1]);
+				} else {
+					assert(false && "unknown constructor");
+				}
 
-			llvm::Value *initialized =
-				builder_.CreateGEP(castedMalloced, builder_.CreateLoad(counter));
+				// the initializer is evaluated for each element
+				generateTemporariesCleanup(temporariesBegin);
 
-			if (ce->params.size() == 1) {
-				generateConstructor(initialized, at->getElemType(), NULL);
-			} else if (ce->params.size() == 2) {
-				generateConstructor(initialized, at->getElemType(), ce->params[1]);
-			} else {
-				assert(false && "unknown constructor");
+				builder_.SetInsertPoint(blocks.back().body);
+				endCountedLoop(loop);
+				blocks.back().body = builder_.GetInsertBlock();
 			}
-
-			// counter += 1
-			builder_.SetInsertPoint(blocks.back().body);
-			builder_.CreateStore(
-				builder_.CreateAdd(builder_.CreateLoad(counter),
-						llvm::ConstantInt::get(getLLVMType(Int_), 1)), counter);
-			builder_.CreateBr(loopCond);
-
-			builder_.SetInsertPoint(loopAfter);
-			blocks.back().body = loopAfter;
 		}
 	} else if (init != NULL) {
 		assert(false && "unkown initializer");
@@ -1455,110 +2589,276 @@ void LLVMCodeGen::Impl::generateArrayConstructor(llvm::Value *dest, Type *type,
 	return;
 }
 
-void LLVMCodeGen::Impl::generateArrayResize(llvm::Value *array, llvm::Value *size,
-		bool checkLength, bool runConstructor) {
-	assert(false && "array resize not implemented");
-
-	assert(!runConstructor ? !checkLength : true);
+// fill count elements with value (the builder is left in the block after the fill):
+// byte-sized values and values made of the same bytes (e.g. zero) are filled by memset,
+// and the others are stored as vectors of kVectorSize bytes
+void LLVMCodeGen::Impl::generateArrayFill(llvm::Value *elements, llvm::Value *count,
+		llvm::Value *elementSize, llvm::Value *value, Type *type) {
+	const unsigned int kVectorSize = 16;
+
+	llvm::Type *lvCount = count->getType();
+	llvm::Type *lvInt8 = llvm::Type::getInt8Ty(context_);
+	llvm::Type *lvType = value->getType();
+	const unsigned int align = getPrimitiveTypeAlignment(type);
+
+	llvm::Value *byte = NULL;
+	if (lvType->isIntegerTy(1) || lvType->isIntegerTy(8)) {
+		byte = builder_.CreateZExt(value, lvInt8);
+	} else if (llvm::isa<llvm::Constant>(value) && llvm::cast<llvm::Constant>(value)->isNullValue()) {
+		byte = llvm::ConstantInt::get(lvInt8, 0);
+	} else if (llvm::isa<llvm::ConstantInt>(value)) {
+		const unsigned long long bits = llvm::cast<llvm::ConstantInt>(value)->getZExtValue();
+		const unsigned long long ones = 0x0101010101010101ull >> (64 - lvType->getIntegerBitWidth());
+		if (bits == (bits & 0xff) * ones)
+			byte = llvm::ConstantInt::get(lvInt8, bits & 0xff);
+	}
+
+	if (byte != NULL) {
+		builder_.CreateMemSet(builder_.CreateBitCast(elements, lvInt8->getPointerTo()),
+					byte, builder_.CreateMul(count, elementSize), align);
+		return;
+	}
 
-	// 0: int length
-	// 1: int capacity
-	// 2: int elementSize
-	// 3: Type* elements for [ Type ] (if Type = Int, then i32*)
+	const unsigned int lanes = kVectorSize / align;
+	assert(lanes > 1);
 
-	// Overview of the following array resize is like this:
-	// if (length <= size) {
-	// 	mallocedSize = size * elementSize
-	// 	elements = PRRealloc(elements, mallocedSize);
-	//	for (i = length; i < size; ++i)
-	// 		construct(elements[i]);
-	//	capacity = size;
-	//	length = size;
-	// } else {
-	//	for (i = size; i < length; ++i)
-	//		destruct(elements[i]);
-	//	length = size
-	// }
+	// elements[0 .. count / lanes * lanes) are stored as vectors
+	llvm::Value *splat = builder_.CreateVectorSplat(lanes, value);
+	llvm::Value *vectors = builder_.CreateBitCast(elements, splat->getType()->getPointerTo());
+	llvm::Value *vectorCount = builder_.CreateSDiv(count, llvm::ConstantInt::get(lvCount, lanes));
 
-	llvm::Function *func = getEnclosingFunc();
 	const std::string curNumStr = getUniqNumStr();
 
-	llvm::Value *length = NULL;
-	{
-		builder_.SetInsertPoint(blocks.back().body);
+	CountedLoop vectorLoop = beginCountedLoop(vectorCount, "fillVectorLoop" + curNumStr);
+	builder_.CreateAlignedStore(splat, builder_.CreateGEP(vectors, vectorLoop.counter), align);
+	endCountedLoop(vectorLoop);
 
-		std::vector<llvm::Value *> params;
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-		llvm::Value *lengthPtr = builder_.CreateGEP(array, params);
-		length = builder_.CreateLoad(lengthPtr);
-	}
+	// the rest of them
+	llvm::Value *filled = builder_.CreateMul(vectorCount, llvm::ConstantInt::get(lvCount, lanes));
+	CountedLoop restLoop = beginCountedLoop(builder_.CreateSub(count, filled), "fillRestLoop" + curNumStr);
+	builder_.CreateStore(value, builder_.CreateGEP(elements, builder_.CreateAdd(filled, restLoop.counter)));
+	endCountedLoop(restLoop);
+
+	return;
+}
+
+// built-in methods of arrays: resize, reserve, push, pop, insert and remove
+// (the runtime moves the elements, and only the changed elements are constructed or destructed)
+llvm::Value *LLVMCodeGen::Impl::generateArrayMethodCall(FuncCallExpr *fce) {
+	assert(fce->func->getASTType() == AST::MEMBER_EXPR);
 
-	llvm::BasicBlock *resizeExpand = llvm::BasicBlock::Create(context_, "resizeExpand" + curNumStr, func);
+	MemberExpr *me = static_cast<MemberExpr *>(fce->func);
+	assert(me->receiver->type->unmodify()->getTypeType() == Type::ARRAY_TYPE);
 
-	llvm::BasicBlock *resizeShrink = NULL;
-	if (checkLength)
-		resizeShrink = llvm::BasicBlock::Create(context_, "resizeShrink" + curNumStr, func);
+	Type *elemType = static_cast<ArrayType *>(me->receiver->type->unmodify())->getElemType();
+	llvm::Type *lvElemPtrType = getLLVMType(elemType)->getPointerTo();
+	const std::string& member = me->member->getString();
+
+	builder_.SetInsertPoint(blocks.back().body);
+	llvm::Value *array = generateExpr(me->receiver);
 
-	llvm::BasicBlock *resizeAfter = llvm::BasicBlock::Create(context_, "resizeAfter" + curNumStr, func);
+	// the elements pushed or inserted are moved into the array
+	std::vector<llvm::Value *> params;
+	for (std::vector<Expr *>::iterator it = fce->params.begin(); it != fce->params.end(); ++it) {
+		if (needsDestructor((*it)->type))
+			params.push_back(generateOwnedExpr(*it));
+		else
+			params.push_back(generateExpr(*it));
+	}
 
 	builder_.SetInsertPoint(blocks.back().body);
-	if (checkLength) {
-		llvm::Value *cond = builder_.CreateICmpSLE(length, size);
-		builder_.CreateCondBr(cond, resizeExpand, resizeShrink);
+	llvm::Value *arrayPtr = builder_.CreateBitCast(array, llvm::Type::getInt8Ty(context_)->getPointerTo());
+
+	if (member == "resize") {
+		assert(params.size() == 1);
+		generateArrayResize(array, params[0], elemType);
+
+	} else if (member == "reserve") {
+		assert(params.size() == 1);
+		std::vector<llvm::Value *> args;
+		args.push_back(arrayPtr);
+		args.push_back(params[0]);
+		builder_.CreateCall(module_.getFunction("PRArrayReserve"), args);
+
+	} else if (member == "push") {
+		assert(params.size() == 1);
+		llvm::Value *slot = builder_.CreateCall(module_.getFunction("PRArrayPush"), arrayPtr);
+		builder_.CreateStore(params[0], builder_.CreateBitCast(slot, lvElemPtrType));
+
+	} else if (member == "insert") {
+		assert(params.size() == 2);
+		std::vector<llvm::Value *> args;
+		args.push_back(arrayPtr);
+		args.push_back(params[0]);
+		llvm::Value *slot = builder_.CreateCall(module_.getFunction("PRArrayInsert"), args);
+		builder_.CreateStore(params[1], builder_.CreateBitCast(slot, lvElemPtrType));
+
+	} else if (member == "pop") {
+		assert(params.empty());
+		// the popped element is moved out of the array
+		llvm::Value *slot = builder_.CreateCall(module_.getFunction("PRArrayPop"), arrayPtr);
+		llvm::Value *res = builder_.CreateLoad(builder_.CreateBitCast(slot, lvElemPtrType));
+		registerTemporary(res, elemType);
+		return res;
+
+	} else if (member == "remove") {
+		assert(params.size() == 1);
+		std::vector<llvm::Value *> args;
+		args.push_back(arrayPtr);
+		args.push_back(params[0]);
+		llvm::Value *slot = builder_.CreateCall(module_.getFunction("PRArrayElement"), args);
+		llvm::Value *removed = builder_.CreateLoad(builder_.CreateBitCast(slot, lvElemPtrType));
+		builder_.CreateCall(module_.getFunction("PRArrayRemove"), args);
+		if (needsDestructor(elemType)) {
+			generateDestructor(removed, elemType);
+			blocks.back().body = builder_.GetInsertBlock();
+		}
+
 	} else {
-		builder_.CreateBr(resizeExpand);
+		assert(false && "unknown array method");
 	}
 
-	blocks.back().body = resizeExpand;
-	builder_.SetInsertPoint(resizeExpand);
+	return NULL;
+}
 
-	llvm::Value *elementSize = NULL;
-	{
-		std::vector<llvm::Value *> params;
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 2));
-		llvm::Value *elementSizePtr = builder_.CreateGEP(array, params);
-		elementSize = builder_.CreateLoad(elementSizePtr);
+void LLVMCodeGen::Impl::generateArrayResize(llvm::Value *array, llvm::Value *size, Type *elemType) {
+	// 0: long long length
+	// 1: long long capacity
+	// 2: int elementSize
+	// 3: Type* elements for [ Type ] (if Type = Int, then i32*)
+
+	// prevLength = PRArrayResize(array, size)
+	// for (i = prevLength; i < size; ++i)
+	// 	construct(elements[i]);
+	// for (i = size; i < prevLength; ++i)
+	// 	destruct(elements[i]);
+
+	builder_.SetInsertPoint(blocks.back().body);
+
+	std::vector<llvm::Value *> args;
+	args.push_back(builder_.CreateBitCast(array, llvm::Type::getInt8Ty(context_)->getPointerTo()));
+	args.push_back(size);
+	llvm::Value *prevLength = builder_.CreateCall(module_.getFunction("PRArrayResize"), args);
+
+	// elements may be reallocated by PRArrayResize
+	std::vector<llvm::Value *> elementsParams;
+	elementsParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+	elementsParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 3));
+	llvm::Value *elements = builder_.CreateLoad(builder_.CreateGEP(array, elementsParams));
+
+	const std::string curNumStr = getUniqNumStr();
+
+	CountedLoop construct = beginCountedLoop(builder_.CreateSub(size, prevLength), "resizeConstruct" + curNumStr);
+	blocks.back().body = builder_.GetInsertBlock();
+	generateConstructor(builder_.CreateGEP(elements, builder_.CreateAdd(prevLength, construct.counter)),
+				elemType, NULL);
+	builder_.SetInsertPoint(blocks.back().body);
+	endCountedLoop(construct);
+
+	if (needsDestructor(elemType)) {
+		CountedLoop destruct = beginCountedLoop(builder_.CreateSub(prevLength, size), "resizeDestruct" + curNumStr);
+		generateDestructor(builder_.CreateLoad(
+			builder_.CreateGEP(elements, builder_.CreateAdd(size, destruct.counter))), elemType);
+		endCountedLoop(destruct);
 	}
 
-	llvm::Value *mallocedSize = builder_.CreateMul(size, elementSize);
+	blocks.back().body = builder_.GetInsertBlock();
+	return;
+}
 
-	llvm::Value *elementsPtr = NULL, *elements = NULL;
-	{
-		std::vector<llvm::Value *> params;
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-		params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 3));
-		elementsPtr = builder_.CreateGEP(array, params);
-		elements = builder_.CreateLoad(elementsPtr);
+// evaluate String or array expression whose value is owned by the caller:
+// temporaries are moved, and the values owned by variables are copied
+llvm::Value *LLVMCodeGen::Impl::generateOwnedExpr(Expr *expr) {
+	llvm::Value *value = generateExpr(expr);
+	if (takeTemporary(value))
+		return value;
+
+	builder_.SetInsertPoint(blocks.back().body);
+	value = generateCopy(value, expr->type);
+	blocks.back().body = builder_.GetInsertBlock();
+
+	return value;
+}
+
+// copy constructor of String and array (the builder may be left in another basic block)
+llvm::Value *LLVMCodeGen::Impl::generateCopy(llvm::Value *value, Type *type) {
+	type = type->unmodify();
+
+	// String is reference counted: ++(value->refCount) (refCount is the first member of struct String)
+	// String literals are immortal but not constant globals, so they are incremented as well
+	// (their refCount starts from PR_STRING_IMMORTAL and never reaches zero nor overflows in practice)
+	if (type->is(String_)) {
+		llvm::Value *refCount = builder_.CreateBitCast(value, getLLVMType(Int_)->getPointerTo());
+		builder_.CreateStore(
+			builder_.CreateAdd(builder_.CreateLoad(refCount), llvm::ConstantInt::get(getLLVMType(Int_), 1)),
+			refCount);
+
+		return value;
 	}
 
-	{
-		llvm::Function *func = module_.getFunction("PRRealloc");
-		assert(func != NULL);
-		std::vector<llvm::Value *> params;
-		params.push_back(builder_.CreateBitCast(elements, llvm::Type::getInt8Ty(context_)->getPointerTo()));
-		params.push_back(mallocedSize);
+	assert(type->getTypeType() == Type::ARRAY_TYPE);
+
+	// 0: long long length
+	// 1: long long capacity
+	// 2: int elementSize
+	// 3: Type* elements for [ Type ] (if Type = Int, then i32*)
+
+	Type *elemType = static_cast<ArrayType *>(type)->getElemType();
+
+	llvm::Value *length = builder_.CreateExtractValue(value, 0);
+	llvm::Value *elementSize = builder_.CreateExtractValue(value, 2);
+	llvm::Value *elements = builder_.CreateExtractValue(value, 3);
+
+	llvm::Value *malloced = builder_.CreateCall(module_.getFunction("PRMalloc"),
+			builder_.CreateMul(length, builder_.CreateZExt(elementSize, length->getType())));
+	llvm::Value *copied = builder_.CreateBitCast(malloced, elements->getType());
+
+	CountedLoop loop = beginCountedLoop(length, "copyLoop" + getUniqNumStr());
+	llvm::Value *element = builder_.CreateLoad(builder_.CreateGEP(elements, loop.counter));
+	if (needsDestructor(elemType))
+		element = generateCopy(element, elemType);
+	builder_.CreateStore(element, builder_.CreateGEP(copied, loop.counter));
+	endCountedLoop(loop);
+
+	llvm::Value *res = builder_.CreateInsertValue(value, length, 1);
+	return builder_.CreateInsertValue(res, copied, 3);
+}
 
-		elements = builder_.CreateBitCast(builder_.CreateCall(func, params), elements->getType());
+// destructor of String and array (the builder may be left in another basic block)
+// the elements of the array are not freed unless freesElements (they are on the stack)
+void LLVMCodeGen::Impl::generateDestructor(llvm::Value *value, Type *type, bool freesElements) {
+	type = type->unmodify();
 
-		builder_.CreateStore(elements, elementsPtr);
+	if (type->is(String_)) {
+		llvm::Function *func = module_.getFunction("PRStringDestructor");
+		assert(func != NULL);
+
+		builder_.CreateCall(func, value);
+		return;
 	}
 
-	if (runConstructor) {
-		//llvm::BasicBlock *
+	assert(type->getTypeType() == Type::ARRAY_TYPE);
+
+	Type *elemType = static_cast<ArrayType *>(type)->getElemType();
+
+	llvm::Value *elements = builder_.CreateExtractValue(value, 3);
+
+	if (needsDestructor(elemType)) {
+		CountedLoop loop = beginCountedLoop(builder_.CreateExtractValue(value, 0),
+						"destructLoop" + getUniqNumStr());
+		generateDestructor(builder_.CreateLoad(builder_.CreateGEP(elements, loop.counter)), elemType);
+		endCountedLoop(loop);
 	}
 
-	// TODO!!!STUB!!!!
+	if (freesElements) {
+		builder_.CreateCall(module_.getFunction("PRFree"),
+			builder_.CreateBitCast(elements, llvm::Type::getInt8Ty(context_)->getPointerTo()));
+	}
 
-	blocks.back().body = resizeAfter;
 	return;
 }
 
 // initialize allocated variable dest with init
-// TODO: to run copy constructor
-// TODO: to run copy constructor and destructor on assignment
-// TODO: to run destructor in cleanup
 void LLVMCodeGen::Impl::generateConstructor(llvm::Value *dest, Type *type, Expr *init) {
 
 	assert(init != NULL ? init->type != NULL : true);
@@ -1580,7 +2880,7 @@ void LLVMCodeGen::Impl::generateConstructor(llvm::Value *dest, Type *type, Expr
 	}
 
 	// these types are primitive
-	if (type->is(Int_) || type->is(Char_) || type->is(Bool_)
+	if (type->is(Int_) || type->is(Char_) || type->is(Bool_) || type->is(Int64_)
 		|| type->is(Float_) || type->is(Double_) || type->is(Label_)) {
 		generatePrimitiveTypeConstructor(dest, type, init);
 
@@ -1634,15 +2934,7 @@ void LLVMCodeGen::Impl::generateConstructor(llvm::Value *dest, Type *type, Expr
 		ft = static_cast<FuncType *>(ft->getCdr());
 	}
 
-	std::string funcName;
-	if (symbol->getSymbolType() == Symbol::EXTERN_SYMBOL) {
-		funcName = symbol->getSymbolName();
-	} else {
-		funcName = symbol->getMangledSymbolName();
-	}
-
-	llvm::Function *func = module_.getFunction(funcName);
-	assert(func != NULL);
+	llvm::Value *func = getValue(symbol);
 
 	builder_.SetInsertPoint(blocks.back().body);
 	builder_.CreateCall(func, params);
@@ -1661,19 +2953,25 @@ void LLVMCodeGen::Impl::generateAssignStmt(AssignStmt *as) {
 
 	llvm::Value *after = NULL;
 
+	const bool isOwned = needsDestructor(as->lhs->type->unmodify());
+
 	llvm::Value *rhs = NULL;
 	if (as->rhs != NULL) {
-		rhs = generateExpr(as->rhs);
+		if (isOwned && as->token.getType() == Token::EQL) {
+			rhs = generateOwnedExpr(as->rhs);
+		} else {
+			rhs = generateExpr(as->rhs);
+		}
 	}
 
 	builder_.SetInsertPoint(blocks.back().body);
 
 	switch (as->token.getType()) {
 	case Token::PLUSPLUS:
-		after = builder_.CreateAdd(before, llvm::ConstantInt::get(getLLVMType(Int_), 1));
+		after = builder_.CreateAdd(before, llvm::ConstantInt::get(before->getType(), 1));
 		break;
 	case Token::MINUSMINUS:
-		after = builder_.CreateSub(before, llvm::ConstantInt::get(getLLVMType(Int_), 1));
+		after = builder_.CreateSub(before, llvm::ConstantInt::get(before->getType(), 1));
 		break;
 	case Token::EQL:
 		assert(rhs != NULL);
@@ -1681,27 +2979,31 @@ void LLVMCodeGen::Impl::generateAssignStmt(AssignStmt *as) {
 		break;
 	case Token::PLUSEQ:
 		assert(rhs != NULL);
-		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)) {
+		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)
+				|| as->lhs->type->unmodify()->is(Int64_)) {
 			after = builder_.CreateAdd(before, rhs);
 		} else if (as->lhs->type->unmodify()->is(Float_) || as->lhs->type->unmodify()->is(Double_)) {
 			after = builder_.CreateFAdd(before, rhs);
 		} else if (as->lhs->type->unmodify()->is(String_)) {
+			// append in place (the runtime copies it before if it is shared)
 			std::vector<llvm::Value *> params;
-			params.push_back(before);
+			params.push_back(beforePtr);
 			params.push_back(rhs);
 
-			llvm::Function *func = module_.getFunction("PRStringConcatenate");
+			llvm::Function *func = module_.getFunction("PRStringAppend");
 			assert(func != NULL);
 
 			builder_.SetInsertPoint(blocks.back().body);
-			after = builder_.CreateCall(func, params);
+			builder_.CreateCall(func, params);
+			return;
 		} else {
 			assert(false && "unknown type");
 		}
 		break;
 	case Token::MINUSEQ:
 		assert(rhs != NULL);
-		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)) {
+		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)
+				|| as->lhs->type->unmodify()->is(Int64_)) {
 			after = builder_.CreateSub(before, rhs);
 		} else if (as->lhs->type->unmodify()->is(Float_) || as->lhs->type->unmodify()->is(Double_)) {
 			after = builder_.CreateFSub(before, rhs);
@@ -1711,7 +3013,8 @@ void LLVMCodeGen::Impl::generateAssignStmt(AssignStmt *as) {
 		break;
 	case Token::STAREQ:
 		assert(rhs != NULL);
-		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)) {
+		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)
+				|| as->lhs->type->unmodify()->is(Int64_)) {
 			after = builder_.CreateMul(before, rhs);
 		} else if (as->lhs->type->unmodify()->is(Float_) || as->lhs->type->unmodify()->is(Double_)) {
 			after = builder_.CreateFMul(before, rhs);
@@ -1721,7 +3024,8 @@ void LLVMCodeGen::Impl::generateAssignStmt(AssignStmt *as) {
 		break;
 	case Token::SLASHEQ:
 		assert(rhs != NULL);
-		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)) {
+		if (as->lhs->type->unmodify()->is(Int_) || as->lhs->type->unmodify()->is(Char_)
+				|| as->lhs->type->unmodify()->is(Int64_)) {
 			after = builder_.CreateSDiv(before, rhs);
 		} else if (as->lhs->type->unmodify()->is(Float_) || as->lhs->type->unmodify()->is(Double_)) {
 			after = builder_.CreateFDiv(before, rhs);
@@ -1738,6 +3042,12 @@ void LLVMCodeGen::Impl::generateAssignStmt(AssignStmt *as) {
 
 	builder_.CreateStore(after, beforePtr);
 
+	// the previous value is destructed after the store so that self assignment is safe
+	if (isOwned) {
+		generateDestructor(before, as->lhs->type);
+		blocks.back().body = builder_.GetInsertBlock();
+	}
+
 	return;
 }
 
@@ -1746,11 +3056,13 @@ void LLVMCodeGen::Impl::generateIfStmt(IfStmt *is) {
 
 	llvm::Function *func = getEnclosingFunc();
 
-	llvm::BasicBlock *ifAfter = llvm::BasicBlock::Create(context_, "ifAfter" + curNumStr, func);
+	llvm::BasicBlock *ifAfter = createBasicBlock("ifAfter" + curNumStr, func);
 
 	// if / else if
 	for (int i = 0, iEnd = is->ifCond.size(); i < iEnd; ++i) {
+		const size_t temporariesBegin = temporaries_.size();
 		llvm::Value *ifCond = generateExpr(is->ifCond[i]);
+		generateTemporariesCleanup(temporariesBegin);
 
 		llvm::BasicBlock *prevBody = blocks.back().body;
 
@@ -1758,11 +3070,11 @@ void LLVMCodeGen::Impl::generateIfStmt(IfStmt *is) {
 		generateCompStmt(is->ifThen[i], true, false, block);
 
 		// block for next else if
-		blocks.back().body = llvm::BasicBlock::Create(context_, "ifElseIf" + curNumStr, func);
+		blocks.back().body = createBasicBlock("ifElseIf" + curNumStr, func);
 
 		// manually connect compound statement blocks
 		builder_.SetInsertPoint(prevBody);
-		builder_.CreateCondBr(ifCond, block.head, blocks.back().body);
+		generateProfiledCondBr(ifCond, block.head, blocks.back().body);
 
 		builder_.SetInsertPoint(block.end);
 		builder_.CreateBr(ifAfter);
@@ -1800,16 +3112,22 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 	// repeatIncr (-> repeatCond)
 	// [repeatBodyEntry -> repeatBodyEnd] (-> repeatIncr)
 	// repeatAfter ( = blocks.back().body)
-	
+	//
+	// repeatInit is the preheader, repeatCond is the header and repeatIncr is the only latch,
+	// so that LLVM recognizes it as a canonical loop whose trip count is cntMax.
+	// The counter is a PHI node in repeatCond unless the body assigns or refers to cnt.
+	// If the body contains gosub, the subroutine returns into the body without passing repeatInit,
+	// so the counter and cntMax are kept in the memory.
+
 	const std::string curNumStr = getUniqNumStr();
 
 	llvm::Function *func = getEnclosingFunc();
-	llvm::BasicBlock *repeatInit = llvm::BasicBlock::Create(context_, "repeatInit" + curNumStr, func);
-	llvm::BasicBlock *repeatCond = llvm::BasicBlock::Create(context_, "repeatCond" + curNumStr, func);
-	llvm::BasicBlock *repeatIncr = llvm::BasicBlock::Create(context_, "repeatIncr" + curNumStr, func);
-	llvm::BasicBlock *repeatBodyEntry = llvm::BasicBlock::Create(context_, "repeatBodyEntry" + curNumStr, func);
-	llvm::BasicBlock *repeatBodyEnd = llvm::BasicBlock::Create(context_, "repeatBodyEnd" + curNumStr, func);
-	llvm::BasicBlock *repeatAfter = llvm::BasicBlock::Create(context_, "repeatAfter" + curNumStr, func);
+	llvm::BasicBlock *repeatInit = createBasicBlock("repeatInit" + curNumStr, func);
+	llvm::BasicBlock *repeatCond = createBasicBlock("repeatCond" + curNumStr, func);
+	llvm::BasicBlock *repeatIncr = createBasicBlock("repeatIncr" + curNumStr, func);
+	llvm::BasicBlock *repeatBodyEntry = createBasicBlock("repeatBodyEntry" + curNumStr, func);
+	llvm::BasicBlock *repeatBodyEnd = createBasicBlock("repeatBodyEnd" + curNumStr, func);
+	llvm::BasicBlock *repeatAfter = createBasicBlock("repeatAfter" + curNumStr, func);
 
 	// begin (blocks.back().body -> ) repeatInit (-> repeatCond)
 
@@ -1826,18 +3144,48 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 		blocks.push_back(block);
 	}
 
+	const size_t temporariesBegin = temporaries_.size();
 	llvm::Value *cntMax = rs->count != NULL ? generateExpr(rs->count) : NULL;
+	generateTemporariesCleanup(temporariesBegin);
+
+	// check the range of the counter once for the arrays subscripted by it (cntMax <= array.length)
+	for (std::vector<Identifier *>::iterator it = rs->rangeCheckedArrays.begin();
+			it != rs->rangeCheckedArrays.end(); ++it) {
+		assert(cntMax != NULL);
+
+		llvm::Value *array = generateExpr(*it);
 
+		std::vector<llvm::Value *> lengthParams;
+		lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+		lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+
+		builder_.SetInsertPoint(blocks.back().body);
+		llvm::Value *length = builder_.CreateLoad(builder_.CreateGEP(array, lengthParams));
+		loopRangeChecks_[std::make_pair(rs, (*it)->symbol)] =
+			builder_.CreateICmpSLE(builder_.CreateSExt(cntMax, length->getType()), length);
+	}
+
+	// the counter is Int64 if the count is Int64
 	Symbol *cntSymbol = rs->scope->resolve("cnt", rs->token.getPosition());
 	assert(cntSymbol != NULL);
-	assert(cntSymbol->getType()->is(Int_));
+	assert(cntSymbol->getType()->is(Int_) || cntSymbol->getType()->is(Int64_));
+	llvm::Type *lvCnt = getLLVMType(cntSymbol->getType());
 
-	builder_.SetInsertPoint(blocks.back().body);
-	llvm::Value *cnt = builder_.CreateAlloca(
-			getLLVMType(Int_), 0, cntSymbol->getMangledSymbolName());
+	llvm::Value *cnt = NULL;
+	if (rs->isCounterModified || rs->hasGosub)
+		cnt = createLocalVariable(cntSymbol, lvCnt);
+
+	llvm::Value *cntMaxVar = NULL;
+	if (rs->hasGosub && cntMax != NULL)
+		cntMaxVar = createEntryBlockAlloca(lvCnt, "cntMax" + curNumStr);
 
-	builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), 0), cnt);
+	builder_.SetInsertPoint(blocks.back().body);
+	if (cnt != NULL)
+		builder_.CreateStore(llvm::ConstantInt::get(lvCnt, 0), cnt);
+	if (cntMaxVar != NULL)
+		builder_.CreateStore(cntMax, cntMaxVar);
 
+	llvm::BasicBlock *repeatPreheader = builder_.GetInsertBlock();
 	builder_.CreateBr(repeatCond);
 
 	assert(blocks.back().type == Block::COMP_BLOCK);
@@ -1847,13 +3195,27 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 
 	// begin repeatCond (-> repeatBodyEntry or -> repeatAfter)
 
+	llvm::PHINode *cntPhi = NULL;
 	{
 		builder_.SetInsertPoint(repeatCond);
 
+		llvm::Value *cntVal = NULL;
+		if (cnt != NULL) {
+			cntVal = builder_.CreateLoad(cnt);
+		} else {
+			cntPhi = builder_.CreatePHI(lvCnt, 2);
+			if (!options_.discardNames)
+				cntPhi->setName(cntSymbol->getMangledSymbolName());
+			cntPhi->addIncoming(llvm::ConstantInt::get(lvCnt, 0), repeatPreheader);
+			counterValues_[cntSymbol] = cntVal = cntPhi;
+		}
+
+		if (cntMaxVar != NULL)
+			cntMax = builder_.CreateLoad(cntMaxVar);
+
 		if (cntMax != NULL) {
-			llvm::Value *cntVal = builder_.CreateLoad(cnt);
 			llvm::Value *cntCmp = builder_.CreateICmpSLT(cntVal, cntMax);
-			builder_.CreateCondBr(cntCmp, repeatBodyEntry, repeatAfter);
+			generateProfiledCondBr(cntCmp, repeatBodyEntry, repeatAfter);
 		} else {
 			// it is an infinite loop
 			builder_.CreateBr(repeatBodyEntry);
@@ -1866,11 +3228,18 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 	
 	{
 		builder_.SetInsertPoint(repeatIncr);
-		llvm::Value *cntVal = builder_.CreateLoad(cnt);
-		llvm::Value *cntIncrVal =
-			builder_.CreateAdd(cntVal,
-				llvm::ConstantInt::get(getLLVMType(Int_), 1));
-		builder_.CreateStore(cntIncrVal, cnt);
+		llvm::Value *cntVal = cntPhi;
+		if (cnt != NULL)
+			cntVal = builder_.CreateLoad(cnt);
+		llvm::Value *one = llvm::ConstantInt::get(lvCnt, 1);
+		// cnt < cntMax never overflows (unless the body modifies it)
+		llvm::Value *cntIncrVal = (cntMax != NULL && cnt == NULL)
+			? builder_.CreateNSWAdd(cntVal, one) : builder_.CreateAdd(cntVal, one);
+		if (cnt != NULL) {
+			builder_.CreateStore(cntIncrVal, cnt);
+		} else {
+			cntPhi->addIncoming(cntIncrVal, repeatIncr);
+		}
 		builder_.CreateBr(repeatCond);
 	}
 
@@ -1893,9 +3262,11 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 		}
 
 		builder_.SetInsertPoint(blocks.back().body);
+		if (!blocks.back().unwinds.empty())
+			builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), 0), getUnwindDest());
 		builder_.CreateBr(blocks.back().end);
 
-		builder_.SetInsertPoint(blocks.back().end);
+		builder_.SetInsertPoint(generateCleanup(blocks.back()));
 		builder_.CreateBr(repeatIncr);
 
 		assert(blocks.back().type == Block::LOOP_BLOCK);
@@ -1912,17 +3283,15 @@ void LLVMCodeGen::Impl::generateRepeatStmt(RepeatStmt *rs) {
 
 }
 
-// TODO: make continue and break pass bodyBlockEnd
 void LLVMCodeGen::Impl::generateContinueStmt(ContinueStmt *cs) {
 
 	Block& loopBlock = getEnclosingLoopBlock();
 
-	builder_.SetInsertPoint(blocks.back().body);
-	builder_.CreateBr(loopBlock.continue_);
+	generateUnwind(loopBlock, true, loopBlock.continue_);
 
 	const std::string curNumStr = getUniqNumStr();
 
-	blocks.back().body = llvm::BasicBlock::Create(context_, "continueAfter" + curNumStr, getEnclosingFunc());
+	blocks.back().body = createBasicBlock("continueAfter" + curNumStr, getEnclosingFunc());
 
 }
 
@@ -1930,77 +3299,182 @@ void LLVMCodeGen::Impl::generateBreakStmt(BreakStmt *bs) {
 
 	Block& loopBlock = getEnclosingLoopBlock();
 
-	builder_.SetInsertPoint(blocks.back().body);
-	builder_.CreateBr(loopBlock.break_);
+	generateUnwind(loopBlock, true, loopBlock.break_);
 
 	const std::string curNumStr = getUniqNumStr();
 
-	blocks.back().body = llvm::BasicBlock::Create(context_, "breakAfter" + curNumStr, getEnclosingFunc());
+	blocks.back().body = createBasicBlock("breakAfter" + curNumStr, getEnclosingFunc());
 
 }
 
-// TODO: after everything's completed
-//
-//
 void LLVMCodeGen::Impl::generateGotoStmt(GotoStmt *gs) {
 	assert(isFunctionalGlobal());
 	assert(gs != NULL);
 	assert(gs->to != NULL);
 	assert(gs->to->symbol != NULL);
+	assert(labelBlocks_.count(gs->to->symbol));
 
-	llvm::Function  *func = module_.getFunction(gs->to->symbol->getMangledSymbolName());
-	assert(func != NULL);
+	generateUnwind(getEnclosingFuncBlock(), false, labelBlocks_[gs->to->symbol]);
 
-	builder_.SetInsertPoint(blocks.back().body);
-	builder_.CreateCall(func);
-	builder_.CreateRetVoid();
-	blocks.back().body = llvm::BasicBlock::Create(context_, "gotoAfter" + getUniqNumStr(), getEnclosingFunc());
+	blocks.back().body = createBasicBlock("gotoAfter" + getUniqNumStr(), getEnclosingFunc());
 
 	return;
 }
 
 void LLVMCodeGen::Impl::generateLabelStmt(LabelStmt *ls) {
-	assert(isFunctionalGlobal());
-
-	llvm::Function  *func = module_.getFunction(ls->label->symbol->getMangledSymbolName());
-	assert(func != NULL);
-
-	llvm::BasicBlock *body = llvm::BasicBlock::Create(context_, "labelEntry" + getUniqNumStr(), func);
-	
-	llvm::BasicBlock *prevBody = blocks.back().body;
+	assert(isNamespaceGlobal());
+	assert(labelBlocks_.count(ls->label->symbol));
 
-	blocks.back().func = func;
-	blocks.back().body = body;
-	blocks.back().end->moveAfter(body);
+	llvm::BasicBlock *labelBlock = labelBlocks_[ls->label->symbol];
 
-	builder_.SetInsertPoint(prevBody);
-	builder_.CreateCall(func);
-	builder_.CreateRetVoid();
 	builder_.SetInsertPoint(blocks.back().body);
+	builder_.CreateBr(labelBlock);
 
+	blocks.back().body = labelBlock;
 
 	return;
 }
 
 void LLVMCodeGen::Impl::generateGosubStmt(GosubStmt *gs) {
 	assert(isFunctionalGlobal());
+	assert(labelBlocks_.count(gs->to->symbol));
 
-	llvm::Function  *func = module_.getFunction(gs->to->symbol->getMangledSymbolName());
-	assert(func != NULL);
+	llvm::Value *gosubStack = getGosubStack();
+
+	llvm::BasicBlock *gosubReturn = createBasicBlock("gosubReturn" + getUniqNumStr(), getEnclosingFunc());
+	gosubReturns_.push_back(gosubReturn);
 
 	builder_.SetInsertPoint(blocks.back().body);
-	builder_.CreateCall(func);
+	gosubCounters_.push_back(allocateProfileCounters(1));
+	generateProfileCount(gosubCounters_.back());
+
+	// the subroutine is measured from the gosub to the return into the block after it
+	int record = -1;
+	if (options_.instrument) {
+		if (!labelRecords_.count(gs->to->symbol))
+			labelRecords_[gs->to->symbol] = createInstrumentRecord(gs->to->symbol->getSymbolName());
+		record = labelRecords_[gs->to->symbol];
+		generateInstrumentEnter(record);
+	}
+
+	// push the id of the block to return
+	llvm::Value *top = builder_.CreateCall(module_.getFunction("PRArrayPush"),
+			builder_.CreateBitCast(gosubStack, llvm::Type::getInt8PtrTy(context_)));
+	builder_.CreateStore(llvm::ConstantInt::get(getLLVMType(Int_), gosubReturns_.size()),
+			builder_.CreateBitCast(top, getLLVMType(Int_)->getPointerTo()));
+	builder_.CreateBr(labelBlocks_[gs->to->symbol]);
+
+	if (options_.instrument) {
+		builder_.SetInsertPoint(gosubReturn);
+		generateInstrumentExit(record);
+	}
+
+	blocks.back().body = gosubReturn;
+
+	return;
+}
+
+// the stack of the return addresses is an array of Int, which lives until the end of the program
+llvm::Value *LLVMCodeGen::Impl::getGosubStack() {
+	if (gosubStack_ != NULL)
+		return gosubStack_;
+
+	gosubStackType_ = new ArrayType(Int_);
+
+	llvm::AllocaInst *gosubStack = createEntryBlockAlloca(getLLVMType(gosubStackType_), "$gosubStack");
 
+	llvm::BasicBlock::iterator next = gosubStack->getIterator();
+	++next;
+	llvm::IRBuilder<> entryBuilder(gosubStack->getParent(), next);
+	entryBuilder.CreateStore(getEmptyArray(static_cast<ArrayType *>(gosubStackType_)), gosubStack);
+
+	Block& globalBlock = getEnclosingFuncBlock();
+	assert(globalBlock.type == Block::GLOBAL_BLOCK);
+	globalBlock.destructed.push_back(std::make_pair(gosubStack, gosubStackType_));
+
+	gosubStack_ = gosubStack;
+	return gosubStack;
+}
+
+// an array of no elements and no capacity
+llvm::Constant *LLVMCodeGen::Impl::getEmptyArray(ArrayType *type) {
+	// long long length
+	// long long capacity
+	// int elementSize
+	// Type* elements for [ Type ]
+	llvm::Type *elemType = getLLVMType(type->getElemType());
+
+	std::vector<llvm::Constant *> members;
+	members.push_back(llvm::ConstantInt::get(getLLVMType(Int64_), 0));
+	members.push_back(llvm::ConstantInt::get(getLLVMType(Int64_), 0));
+	members.push_back(llvm::ConstantExpr::getTrunc(llvm::ConstantExpr::getSizeOf(elemType), getLLVMType(Int_)));
+	members.push_back(llvm::ConstantPointerNull::get(elemType->getPointerTo()));
+
+	return llvm::ConstantStruct::get(static_cast<llvm::StructType *>(getLLVMType(type)), members);
+}
+
+// the return statements in the main code jump there
+llvm::BasicBlock *LLVMCodeGen::Impl::getGlobalReturn() {
+	if (globalReturn_ == NULL)
+		globalReturn_ = createBasicBlock("globalReturn", getEnclosingFunc());
+
+	return globalReturn_;
+}
+
+// return to the last gosub, or finish the program if there is none
+void LLVMCodeGen::Impl::generateGlobalReturn() {
+	Block& globalBlock = getEnclosingFuncBlock();
+	assert(globalBlock.type == Block::GLOBAL_BLOCK);
+
+	builder_.SetInsertPoint(globalReturn_);
+
+	if (gosubReturns_.empty()) {
+		builder_.CreateBr(globalBlock.end);
+		return;
+	}
+
+	const std::string curNumStr = getUniqNumStr();
+	llvm::BasicBlock *gosubPop = createBasicBlock("gosubPop" + curNumStr, globalBlock.func);
+	llvm::BasicBlock *gosubInvalid = createBasicBlock("gosubInvalid" + curNumStr, globalBlock.func);
+
+	llvm::Value *gosubStack = getGosubStack();
+
+	std::vector<llvm::Value *> lengthParams;
+	lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+	lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+	llvm::Value *depth = builder_.CreateLoad(builder_.CreateGEP(gosubStack, lengthParams));
+	builder_.CreateCondBr(builder_.CreateICmpEQ(depth, llvm::ConstantInt::get(depth->getType(), 0)),
+			globalBlock.end, gosubPop);
+
+	builder_.SetInsertPoint(gosubPop);
+	llvm::Value *top = builder_.CreateCall(module_.getFunction("PRArrayPop"),
+			builder_.CreateBitCast(gosubStack, llvm::Type::getInt8PtrTy(context_)));
+	llvm::Value *id = builder_.CreateLoad(builder_.CreateBitCast(top, getLLVMType(Int_)->getPointerTo()));
+
+	llvm::SwitchInst *si = builder_.CreateSwitch(id, gosubInvalid, gosubReturns_.size());
+	for (size_t i = 0; i < gosubReturns_.size(); ++i) {
+		si->addCase(llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_), i + 1), gosubReturns_[i]);
+	}
+
+	// each subroutine returns as many times as it is called from each place
+	if (!profile_.empty()) {
+		std::vector<int> counters(1, -1);
+		counters.insert(counters.end(), gosubCounters_.begin(), gosubCounters_.end());
+		profiledBranches_.push_back(std::make_pair(si, counters));
+	}
+
+	builder_.SetInsertPoint(gosubInvalid);
+	builder_.CreateUnreachable();
 
 	return;
 }
+
 void LLVMCodeGen::Impl::generateGlobalReturnStmt(ReturnStmt *rs) {
 	assert(isFunctionalGlobal());
 
-	builder_.SetInsertPoint(blocks.back().body);
-	builder_.CreateRetVoid();
+	generateUnwind(getEnclosingFuncBlock(), false, getGlobalReturn());
 
-	blocks.back().body = llvm::BasicBlock::Create(context_, "globalReturnAfter" + getUniqNumStr(), getEnclosingFunc());
+	blocks.back().body = createBasicBlock("globalReturnAfter" + getUniqNumStr(), getEnclosingFunc());
 
 	return;
 }
@@ -2008,32 +3482,45 @@ void LLVMCodeGen::Impl::generateGlobalReturnStmt(ReturnStmt *rs) {
 void LLVMCodeGen::Impl::generateFuncReturnStmt(ReturnStmt *rs) {
 
 	llvm::Value *from = NULL;
-	if (rs->expr != NULL)
-		from = generateExpr(rs->expr);
+	if (rs->expr != NULL && rs->expr->getASTType() == AST::FUNC_CALL_EXPR) {
+		// the returned value of the call is always a temporary
+		from = generateFuncCallExpr(static_cast<FuncCallExpr *>(rs->expr), true);
+		if (from == NULL)
+			return;
+		takeTemporary(from);
+	} else if (rs->expr != NULL) {
+		if (needsDestructor(rs->expr->type->unmodify())) {
+			from = generateOwnedExpr(rs->expr);
+		} else {
+			from = generateExpr(rs->expr);
+		}
+	}
 
 	const std::string curNumStr = getUniqNumStr();
 
-	// TODO: implement higher level unwind
 	builder_.SetInsertPoint(blocks.back().body);
 	Block& funcBlock = getEnclosingFuncBlock();
 	if (from != NULL)
 		builder_.CreateStore(from, funcBlock.retVal);
-	builder_.CreateBr(funcBlock.end);
-	blocks.back().body = llvm::BasicBlock::Create(context_, "funcReturnAfter" + curNumStr, funcBlock.func);
+
+	generateTemporariesCleanup();
+	generateUnwind(funcBlock, false, funcBlock.end);
+
+	blocks.back().body = createBasicBlock("funcReturnAfter" + curNumStr, funcBlock.func);
 
 	return;
 }
 
 llvm::Value *LLVMCodeGen::Impl::generateSubscrExpr(SubscrExpr *se) {
 
-	// 0: int length
-	// 1: int capacity
+	// 0: long long length
+	// 1: long long capacity
 	// 2: int elementSize
 	// 3: Type* elements for [ Type ] (if Type = Int, then i32*)
 
 	assert(se->array);
 	assert(se->subscript);
-	assert(se->subscript->type->unmodify()->is(Int_));
+	assert(se->subscript->type->unmodify()->is(Int_) || se->subscript->type->unmodify()->is(Int64_));
 
 	builder_.SetInsertPoint(blocks.back().body);
 	llvm::Value *array = generateExpr(se->array);
@@ -2045,6 +3532,9 @@ llvm::Value *LLVMCodeGen::Impl::generateSubscrExpr(SubscrExpr *se) {
 	llvm::Value *elements = builder_.CreateGEP(array, elementsParams);
 	llvm::Value *elementsValue = builder_.CreateLoad(elements);
 	
+	if (se->rangeCheck != SubscrExpr::UNCHECKED)
+		generateRangeCheck(se, array, subscr);
+
 	std::vector<llvm::Value *> elementParams;
 	elementParams.push_back(subscr);
 	llvm::Value *element = builder_.CreateGEP(elementsValue, elementParams);
@@ -2053,6 +3543,43 @@ llvm::Value *LLVMCodeGen::Impl::generateSubscrExpr(SubscrExpr *se) {
 	return element;
 }
 
+// abort unless 0 <= subscr < array.length (the builder is left in the block after the check)
+void LLVMCodeGen::Impl::generateRangeCheck(SubscrExpr *se, llvm::Value *array, llvm::Value *subscr) {
+	llvm::Function *func = getEnclosingFunc();
+	const std::string curNumStr = getUniqNumStr();
+
+	llvm::BasicBlock *rangeError = createBasicBlock("rangeError" + curNumStr, func);
+	llvm::BasicBlock *rangeOk = createBasicBlock("rangeOk" + curNumStr, func);
+
+	// the check before the loop usually succeeds
+	if (se->rangeCheck == SubscrExpr::LOOP_CHECKED) {
+		Symbol *symbol = static_cast<Identifier *>(se->array)->symbol;
+		llvm::Value *loopChecked = loopRangeChecks_[std::make_pair(se->rangeLoop, symbol)];
+		assert(loopChecked != NULL);
+
+		llvm::BasicBlock *rangeCheck = createBasicBlock("rangeCheck" + curNumStr, func);
+		builder_.CreateCondBr(loopChecked, rangeOk, rangeCheck);
+		builder_.SetInsertPoint(rangeCheck);
+	}
+
+	std::vector<llvm::Value *> lengthParams;
+	lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+	lengthParams.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
+	llvm::Value *length = builder_.CreateLoad(builder_.CreateGEP(array, lengthParams));
+
+	// negative subscripts are rejected as they are huge when unsigned
+	subscr = builder_.CreateSExt(subscr, length->getType());
+	builder_.CreateCondBr(builder_.CreateICmpULT(subscr, length), rangeOk, rangeError);
+
+	builder_.SetInsertPoint(rangeError);
+	builder_.CreateCall(module_.getFunction("PRArrayIndexOutOfRange"));
+	builder_.CreateUnreachable();
+
+	builder_.SetInsertPoint(rangeOk);
+	blocks.back().body = rangeOk;
+	return;
+}
+
 llvm::Value *LLVMCodeGen::Impl::generateMemberExpr(MemberExpr *me) {
 	assert(me != NULL);
 	assert(me->receiver != NULL);
@@ -2060,11 +3587,12 @@ llvm::Value *LLVMCodeGen::Impl::generateMemberExpr(MemberExpr *me) {
 	assert(me->receiver->type != NULL);
 
 	if (me->receiver->type->unmodify()->getTypeType() == Type::ARRAY_TYPE) {
-		if (me->member->getString() == "length") {
-			// [Type].length :: const ref Int
+		if (me->member->getString() == "length" || me->member->getString() == "longLength") {
+			// [Type].length :: const Int (truncated)
+			// [Type].longLength :: const Int64
 
-			// 0: int length
-			// 1: int capacity
+			// 0: long long length
+			// 1: long long capacity
 			// 2: int elementSize
 			// 3: Type* elements for [ Type ] (if Type = Int, then i32*)
 
@@ -2074,8 +3602,8 @@ llvm::Value *LLVMCodeGen::Impl::generateMemberExpr(MemberExpr *me) {
 			std::vector<llvm::Value *> params;
 			params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
 			params.push_back(llvm::ConstantInt::get(getLLVMType(Int_), 0));
-			llvm::Value *length = builder_.CreateGEP(array, params);
-			return length;
+			llvm::Value *length = builder_.CreateLoad(builder_.CreateGEP(array, params));
+			return builder_.CreateTrunc(length, getLLVMType(me->type->unmodify()));
 		} else {
 			assert(false && "the member for Array is not impelmented yet");
 		}
@@ -2103,25 +3631,5 @@ llvm::Value *LLVMCodeGen::Impl::generateMemberExpr(MemberExpr *me) {
 	}
 }
 
-llvm::Value *LLVMCodeGen::Impl::lookup(const std::string& str) {
-	{
-		llvm::ValueSymbolTable& funcVST = getEnclosingFunc()->getValueSymbolTable();
-
-		llvm::Value *found = funcVST.lookup(str);
-		if (found != NULL)
-			return found;
-	}
-
-	{
-		llvm::ValueSymbolTable& globalVST = module_.getValueSymbolTable();
-
-		llvm::Value *found = globalVST.lookup(str);
-		if (found != NULL)
-			return found;
-	}
-
-	return NULL;
-}
-
 }
 
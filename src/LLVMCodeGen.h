@@ -6,13 +6,14 @@
 namespace Peryan {
 
 class Parser;
+class Options;
 
 class LLVMCodeGen : public CodeGen {
 private:
 	class Impl;
 	Impl *impl_;
 public:
-	LLVMCodeGen(Parser& parser, const std::string& fileName);
+	LLVMCodeGen(Parser& parser, Options& options, const std::string& fileName);
 
 	virtual void generate();
 
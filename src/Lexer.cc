@@ -416,6 +416,11 @@ void Lexer::readSources() {
 
 	// std::cout<<"source_: "<<source_<<std::endl;
 
+	for (Position i = 0; i < static_cast<int>(source_.size()); ++i) {
+		if (source_[i] == '\n')
+			newlines_.push_back(i);
+	}
+
 	return;
 }
 
@@ -430,21 +435,35 @@ void Lexer::getline(std::istream& is, std::string& str) {
 	return;
 }
 
-std::string Lexer::getPrettyPrint(Position pos, std::string message) const {
+bool Lexer::isInMainSource(Position pos) const {
 	const Breadcrumb& bc =
 		*(std::upper_bound(breadcrumbs_.begin(), breadcrumbs_.end(), pos, Breadcrumb::compare) - 1);
 
-	const std::string& name = bc.name;
-	int lineNum = 1 + bc.line;
+	return bc.name == sr_.getMainName();
+}
 
-	Position lastTerm = bc.totalPos - 1;
-	for (Position i = bc.totalPos; i < pos; ++i) {
-		if (source_[i] == '\n') {
-			lineNum++;
-			lastTerm = i;
-		}
-	}
-	int posInLine = pos - lastTerm;
+// the stream name, the line number and the column (both from 1) of the position
+void Lexer::getSourceLocation(Position pos, std::string& name, int& line, int& column) const {
+	const Breadcrumb& bc =
+		*(std::upper_bound(breadcrumbs_.begin(), breadcrumbs_.end(), pos, Breadcrumb::compare) - 1);
+
+	std::vector<Position>::const_iterator first =
+		std::lower_bound(newlines_.begin(), newlines_.end(), bc.totalPos);
+	std::vector<Position>::const_iterator last =
+		std::lower_bound(newlines_.begin(), newlines_.end(), pos);
+
+	name = bc.name;
+	line = 1 + bc.line + (last - first);
+	column = pos - (last != first ? *(last - 1) : bc.totalPos - 1);
+	return;
+}
+
+std::string Lexer::getPrettyPrint(Position pos, std::string message) const {
+	std::string name;
+	int lineNum, posInLine;
+	getSourceLocation(pos, name, lineNum, posInLine);
+
+	Position lastTerm = pos - posInLine;
 
 	int tabs = 0;
 	std::string line;
@@ -61,6 +61,8 @@ private:
 	};
 
 	std::vector<Breadcrumb> breadcrumbs_;
+	// positions of the line terminators in source_
+	std::vector<Position> newlines_;
 
 	std::vector<std::pair<std::string, Token::Type> > keywords;
 
@@ -101,6 +103,8 @@ private:
 
 public:
 	std::string getPrettyPrint(Position pos, std::string message = std::string()) const;
+	void getSourceLocation(Position pos, std::string& name, int& line, int& column) const;
+	bool isInMainSource(Position pos) const;
 
 	Token getNextToken();
 	Position getPosition() { return p_; }
@@ -7,6 +7,9 @@
 #include "FileSourceReader.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "ConstantFolder.h"
+#include "BoundsChecker.h"
+#include "EscapeAnalyzer.h"
 #include "LLVMCodeGen.h"
 
 #ifdef _WIN32
@@ -33,6 +36,22 @@ int main(int argc, char *argv[])
 			warnings.add(-1, "warning: using HSP compatible mode");
 		} else if (cur == "--dump-tokens") {
 			opt.dumpTokens = true;
+		} else if (cur == "--bounds-check") {
+			opt.boundsCheck = true;
+		} else if (cur == "-O") {
+			opt.optLevel = 2;
+		} else if (cur.size() == 3 && cur.find("-O") == 0 && cur[2] >= '0' && cur[2] <= '3') {
+			opt.optLevel = cur[2] - '0';
+		} else if (cur == "-g") {
+			opt.debugInfo = true;
+		} else if (cur == "--profile-generate") {
+			opt.profileGenerate = true;
+		} else if (cur.find("--profile-use=") == 0) {
+			opt.profileUse = cur.substr(std::string("--profile-use=").size());
+		} else if (cur == "--instrument") {
+			opt.instrument = true;
+		} else if (cur == "--release") {
+			opt.discardNames = true;
 		} else if (cur == "--runtime-path") {
 			if (i + 1 >= argc) {
 				std::cerr<<"error: no directory specified for --runtime-path"<<std::endl;
@@ -49,6 +68,14 @@ int main(int argc, char *argv[])
 				opt.tmpDir = std::string(argv[i + 1]);
 				++i;
 			}
+		} else if (cur == "--jobs" || cur == "-j") {
+			if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+				std::cerr<<"error: no number of threads specified for --jobs"<<std::endl;
+				return 1;
+			} else {
+				opt.jobs = atoi(argv[i + 1]);
+				++i;
+			}
 		}/* else if (cur == "--runtime") {
 			if (i + 1 >= argc) {
 				std::cerr<<"error: no runtime specified for --runtime"<<std::endl;
@@ -95,8 +122,16 @@ int main(int argc, char *argv[])
 		std::cerr<<" --runtime-path <dir>\tSpecify the runtime directory"<<std::endl;
 		// std::cerr<<" --runtime (unixcl|win32)\t\tSpecify the runtime to link"<<std::endl;
 		std::cerr<<" --tmp-dir <dir>\tSpecify a temporary directory"<<std::endl;
+		std::cerr<<" --jobs, -j <n>\t\tAnalyze function bodies on <n> threads"<<std::endl;
 		std::cerr<<" --verbose, -v\t\tDisplay the internal progress of the compiler"<<std::endl;
 		std::cerr<<" --hsp-compatible, -hsp\tEnable HSP compatible behaviors"<<std::endl;
+		std::cerr<<" -O<level>\t\tOptimize the generated code (0 to 3, -O is -O2)"<<std::endl;
+		std::cerr<<" -g\t\t\tGenerate debug information for gdb and perf"<<std::endl;
+		std::cerr<<" --profile-generate\tWrite the profile of the branches to peryan.prof at exit"<<std::endl;
+		std::cerr<<" --profile-use=<file>\tOptimize the branches with the profile"<<std::endl;
+		std::cerr<<" --instrument\t\tPrint the calls and the cycles of each function at exit"<<std::endl;
+		std::cerr<<" --release\t\tDon't name the values in the generated code (faster compilation)"<<std::endl;
+		std::cerr<<" --bounds-check\t\tCheck the subscripts of arrays at runtime"<<std::endl;
 		std::cerr<<" --dump-ast\t\tDump the abstruct syntax tree generated internally (for debug)"<<std::endl;
 		std::cerr<<" --dump-tokens\t\tDump the tokens generated internally (for debug)"<<std::endl;
 
@@ -121,6 +156,18 @@ int main(int argc, char *argv[])
 #endif
 	}
 
+	// only the unixcl runtime writes the profile and the records of the functions
+	if (opt.runtime == "win32") {
+		if (opt.profileGenerate) {
+			std::cerr<<"error: --profile-generate is not supported by the win32 runtime"<<std::endl;
+			return 1;
+		}
+		if (opt.instrument) {
+			std::cerr<<"error: --instrument is not supported by the win32 runtime"<<std::endl;
+			return 1;
+		}
+	}
+
 	if (opt.verbose) {
 		std::cerr<<"Peryan Compiler (C) peryaudo"<<std::endl<<std::endl;
 	}
@@ -192,6 +239,25 @@ int main(int argc, char *argv[])
 
 	if (!opt.inhibitWarnings) warnings.print(lexer);
 
+	// Optimizer
+
+	if (opt.verbose) std::cerr<<"folding constants...";
+	Peryan::ConstantFolder constantFolder(parser.getSymbolTable(), opt, warnings);
+	constantFolder.visit(parser.getTransUnit());
+	if (opt.verbose) std::cerr<<"ok."<<std::endl;
+
+	if (opt.boundsCheck) {
+		if (opt.verbose) std::cerr<<"eliminating bounds checks...";
+		Peryan::BoundsChecker boundsChecker(parser.getSymbolTable(), opt, warnings);
+		boundsChecker.visit(parser.getTransUnit());
+		if (opt.verbose) std::cerr<<"ok."<<std::endl;
+	}
+
+	if (opt.verbose) std::cerr<<"analyzing escapes...";
+	Peryan::EscapeAnalyzer escapeAnalyzer(parser.getSymbolTable(), opt, warnings);
+	escapeAnalyzer.visit(parser.getTransUnit());
+	if (opt.verbose) std::cerr<<"ok."<<std::endl;
+
 	if (opt.dumpAST) {
 		Peryan::ASTPrinter printer(/* pretty = */true, /* type = */true);
 		std::cerr<<printer.toString(parser.getTransUnit())<<std::endl;
@@ -199,15 +265,31 @@ int main(int argc, char *argv[])
 
 	// Code generator
 
-	Peryan::LLVMCodeGen codeGen(parser, opt.tmpDir + std::string("/tmp.ll"));
+	Peryan::LLVMCodeGen codeGen(parser, opt, opt.tmpDir + std::string("/tmp.ll"));
 	
 	if (opt.verbose) std::cerr<<"generating LLVM IR...";
 	codeGen.generate();
 	if (opt.verbose) std::cerr<<"ok."<<std::endl;
 
+	std::string irFileName = opt.tmpDir + "/tmp.ll";
+
+	if (opt.optLevel > 0) {
+		std::stringstream ss;
+		ss<<"opt -O"<<opt.optLevel<<" -o \""<<opt.tmpDir<<"/tmp.bc\" \""<<irFileName<<"\"";
+		if (opt.verbose) std::cerr<<ss.str()<<std::endl;
+		if (system(ss.str().c_str())) {
+			std::cerr<<"error: error while optimizing LLVM IR"<<std::endl;
+			return 1;
+		}
+		irFileName = opt.tmpDir + "/tmp.bc";
+	}
+
 	{
 		std::stringstream ss;
-		ss<<"llc -filetype=obj -o \""<<opt.tmpDir<<"/tmp.o\" \""<<opt.tmpDir<<"/tmp.ll\"";
+		ss<<"llc -filetype=obj";
+		if (opt.optLevel > 0)
+			ss<<" -O"<<opt.optLevel;
+		ss<<" -o \""<<opt.tmpDir<<"/tmp.o\" \""<<irFileName<<"\"";
 		if (opt.verbose) std::cerr<<ss.str()<<std::endl;
 		if (system(ss.str().c_str())) {
 			std::cerr<<"error: error while compiling LLVM IR"<<std::endl;
@@ -219,7 +301,7 @@ int main(int argc, char *argv[])
 		std::stringstream ss;
 		if (opt.runtime == "unixcl")
 		{
-			ss<<"gcc -s -w -lm -o \""<<opt.outputFileName<<"\"";
+			ss<<"gcc "<<(opt.debugInfo ? "" : "-s ")<<"-w -lm -o \""<<opt.outputFileName<<"\"";
 			ss<<" \""<<opt.tmpDir<<"/tmp.o\" \""<<opt.runtimePath<<"/"<<opt.runtime<<".o\"";
 		}
 		else if (opt.runtime == "win32")
@@ -13,13 +13,21 @@ public:
 	bool hspCompat;
 	bool dumpTokens;
 	bool inhibitWarnings;
+	bool boundsCheck; // check the subscripts of arrays at runtime
+	int jobs; // number of threads used by the semantic analysis of function bodies
+	int optLevel; // optimization level of the generated code (0 to 3)
+	bool discardNames; // leave the values and the basic blocks in the generated code unnamed
+	bool debugInfo; // emit DWARF debug information and don't strip the executable
+	bool profileGenerate; // count the branches taken and write the profile at exit
+	std::string profileUse; // profile to optimize the branches with
+	bool instrument; // count the calls and the cycles of the functions and print them at exit
 	std::string mainFileName;
 	std::vector<std::string> includePaths;
 	std::string outputFileName;
 	std::string runtimePath;
 	std::string tmpDir;
 	std::string runtime;
-	Options() : dumpAST(false), verbose(false), hspCompat(false), dumpTokens(false), inhibitWarnings(false) {}
+	Options() : dumpAST(false), verbose(false), hspCompat(false), dumpTokens(false), inhibitWarnings(false), boundsCheck(false), jobs(1), optLevel(0), discardNames(false), debugInfo(false), profileGenerate(false), instrument(false) {}
 };
 
 }
@@ -279,6 +279,7 @@ FuncDefStmt *Parser::parseFuncDefStmt() {
 	fds->params = params;
 	fds->retTypeSpec = retTypeSpec;
 	fds->defaults = defaults;
+	fds->isLibrary = !lexer_.isInMainSource(token.getPosition());
 
 	return fds;
 }
@@ -134,6 +134,8 @@ public:
 	TransUnit *getTransUnit() { return transUnit_; }
 
 	SymbolTable& getSymbolTable() { return symbolTable_; }
+
+	Lexer& getLexer() { return lexer_; }
 };
 
 }
@@ -204,6 +204,12 @@ void SymbolRegister::visit(LabelStmt *ls) {
 				"error: use of labels is deprecated. if you want to use them, try --hsp-compatible .");
 	}
 
+	// labels are basic blocks of the main function
+	if (scope->getScopeType() == Scope::LOCAL_SCOPE) {
+		throw SemanticsError(ls->label->token.getPosition(),
+				"error: labels must be at the top level");
+	}
+
 	if (isDisallowedIdentifier(ls->label->token.getString())) {
 		throw SemanticsError(ls->label->token.getPosition(),
 				std::string("error: you can't use ")
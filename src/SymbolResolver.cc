@@ -4,6 +4,8 @@
 // so SymbolResolver won't resolve such symbols. (right hand side of MemberExpr, StaticMemberExpr)
 
 #include <iostream>
+#include <algorithm>
+#include <thread>
 
 #include "SymbolTable.h"
 #include "SymbolResolver.h"
@@ -27,12 +29,122 @@ void SymbolResolver::visit(TransUnit *tu) {
 
 	assert(scopes.empty());
 
+	resolvePendingBodies();
+
+	return;
+}
+
+// After the top level is resolved, nothing but function bodies writes to the symbol table
+// (they only define symbols in their own local scopes), so the bodies can be resolved concurrently.
+// Implicit global variables of HSP compatible mode break this, so they are always resolved in order.
+bool SymbolResolver::shouldDeferBodies() {
+	return !isWorker_ && options_.jobs > 1 && !options_.hspCompat;
+}
+
+// Bodies are resolved in waves: each wave may refer to library functions
+// whose bodies haven't been resolved yet, and they form the next wave.
+void SymbolResolver::resolvePendingBodies() {
+	while (true) {
+		for (std::vector<FuncSymbol *>::iterator it = referenced_.begin(); it != referenced_.end(); ++it) {
+			std::map<FuncSymbol *, PendingBody>::iterator found = lazyBodies_.find(*it);
+			if (found != lazyBodies_.end()) {
+				pendingBodies_.push_back(found->second);
+				lazyBodies_.erase(found);
+			}
+		}
+		referenced_.clear();
+
+		if (pendingBodies_.empty())
+			break;
+
+		std::vector<PendingBody> bodies;
+		bodies.swap(pendingBodies_);
+
+		if (shouldDeferBodies()) {
+			resolveBodiesConcurrently(bodies);
+		} else {
+			for (std::vector<PendingBody>::iterator it = bodies.begin(); it != bodies.end(); ++it) {
+				scopes = it->scopes;
+				it->fds->body->accept(this);
+			}
+			scopes = std::stack<Scope *>();
+		}
+	}
+
+	// nothing refers to the rest, so that they won't be type checked nor generated
+	for (std::map<FuncSymbol *, PendingBody>::iterator it = lazyBodies_.begin(); it != lazyBodies_.end(); ++it) {
+		if (options_.verbose) std::cerr<<"unused function "<<it->first->getSymbolName()<<" skipped."<<std::endl;
+		it->first->isUnused = true;
+	}
+	lazyBodies_.clear();
+
+	return;
+}
+
+void SymbolResolver::resolveBodiesConcurrently(std::vector<PendingBody>& bodies) {
+	const int jobs = std::min(options_.jobs, static_cast<int>(bodies.size()));
+
+	std::vector<WarningPrinter *> wps;
+	std::vector<SymbolResolver *> workers;
+	for (int i = 0; i < jobs; ++i) {
+		wps.push_back(new WarningPrinter());
+		workers.push_back(new SymbolResolver(symbolTable_, options_, *wps.back()));
+		workers.back()->isWorker_ = true;
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < jobs; ++i) {
+		threads.push_back(std::thread(&SymbolResolver::resolveBodies, workers[i], &bodies, i, jobs));
+	}
+	for (int i = 0; i < jobs; ++i) {
+		threads[i].join();
+	}
+
+	wp_.merge(wps);
+
+	// report the error which appears first in the source
+	std::vector<SemanticsError> errors;
+	for (int i = 0; i < jobs; ++i) {
+		errors.insert(errors.end(), workers[i]->errors_.begin(), workers[i]->errors_.end());
+		referenced_.insert(referenced_.end(), workers[i]->referenced_.begin(), workers[i]->referenced_.end());
+		delete workers[i];
+		delete wps[i];
+	}
+
+	if (!errors.empty()) {
+		SemanticsError *first = &errors[0];
+		for (std::vector<SemanticsError>::iterator it = errors.begin(); it != errors.end(); ++it) {
+			if (it->getPosition() < first->getPosition())
+				first = &(*it);
+		}
+		throw *first;
+	}
+
+	return;
+}
+
+// runs on a worker thread and resolves bodies[first], bodies[first + step], ...
+void SymbolResolver::resolveBodies(std::vector<PendingBody> *bodies, int first, int step) {
+	for (int i = first; i < static_cast<int>(bodies->size()); i += step) {
+		scopes = (*bodies)[i].scopes;
+		try {
+			(*bodies)[i].fds->body->accept(this);
+		} catch (SemanticsError& se) {
+			errors_.push_back(se);
+			return;
+		}
+	}
+
 	return;
 }
 
 void SymbolResolver::visit(FuncDefStmt *fds) {
 	assert(fds != NULL);
 
+	// only library functions in the global scope are resolved lazily
+	// (the others can be referred without any identifier resolved here, e.g. by StaticMemberExpr)
+	const bool isLazy = fds->isLibrary && scopes.top() == symbolTable_.getGlobalScope();
+
 	scopes.push(fds->symbol);
 
 	if (fds->retTypeSpec != NULL) {
@@ -71,7 +183,13 @@ void SymbolResolver::visit(FuncDefStmt *fds) {
 		curType = new FuncType(symbolTable_.Void_, curType);
 	}
 
-	fds->body->accept(this);
+	if (isLazy) {
+		lazyBodies_.insert(std::make_pair(fds->symbol, PendingBody(fds, scopes)));
+	} else if (shouldDeferBodies()) {
+		pendingBodies_.push_back(PendingBody(fds, scopes));
+	} else {
+		fds->body->accept(this);
+	}
 
 	fds->symbol->setType(curType);
 
@@ -258,6 +376,9 @@ void SymbolResolver::visit(Identifier *id) {
 					std::string("error : unknown identifier ") + id->getString());
 			}
 		}
+		if (symbol->getSymbolType() == Symbol::FUNC_SYMBOL) {
+			referenced_.push_back(static_cast<FuncSymbol *>(symbol));
+		}
 		id->symbol = symbol;
 	}
 
@@ -372,8 +493,12 @@ void SymbolResolver::visit(MemberExpr *me) {
 
 	me->receiver->accept(this);
 
-	// won't visit identifier in usual case
-	if (options_.hspCompat && me->member->getString() != "length") {
+	const std::string& member = me->member->getString();
+
+	// won't visit identifier in usual case (nor the built-in members)
+	if (options_.hspCompat && member != "length" && member != "longLength"
+		&& member != "resize" && member != "reserve" && member != "push"
+		&& member != "pop" && member != "insert" && member != "remove") {
 		me->member->accept(this);
 	}
 
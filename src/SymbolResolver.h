@@ -2,6 +2,8 @@
 #define PERYAN_SYMBOL_RESOLVER_H__
 
 #include <stack>
+#include <vector>
+#include <map>
 
 #include "SymbolTable.h"
 #include "AST.h"
@@ -22,9 +24,32 @@ private:
 	WarningPrinter& wp_;
 
 	std::stack<Scope *> scopes;
+
+	// function bodies resolved after the top level (on several threads if --jobs is given)
+	class PendingBody {
+	public:
+		FuncDefStmt *fds;
+		std::stack<Scope *> scopes;
+		PendingBody(FuncDefStmt *fds, const std::stack<Scope *>& scopes)
+			: fds(fds), scopes(scopes) {}
+	};
+	std::vector<PendingBody> pendingBodies_;
+
+	// bodies of the library functions, which are resolved only after the functions are referenced
+	std::map<FuncSymbol *, PendingBody> lazyBodies_;
+	std::vector<FuncSymbol *> referenced_;
+
+	// true for resolvers running on worker threads
+	bool isWorker_;
+	std::vector<SemanticsError> errors_;
+
+	bool shouldDeferBodies();
+	void resolvePendingBodies();
+	void resolveBodiesConcurrently(std::vector<PendingBody>& bodies);
+	void resolveBodies(std::vector<PendingBody> *bodies, int first, int step);
 public:
 	SymbolResolver(SymbolTable& symbolTable, Options& options, WarningPrinter& wp)
-		: symbolTable_(symbolTable), options_(options), wp_(wp) {}
+		: symbolTable_(symbolTable), options_(options), wp_(wp), isWorker_(false) {}
 
 	virtual void visit(TransUnit *tu);
 
@@ -46,6 +46,15 @@ public:
 
 	virtual TypeType getTypeType() { return TYPE; }
 
+	// dense ids of the builtin types, which index the promotion and operator tables
+	typedef enum {
+		BOOL_ID, CHAR_ID, INT_ID, FLOAT_ID, DOUBLE_ID, STRING_ID, VOID_ID, LABEL_ID, INT64_ID,
+		BUILTIN_ID_NUM,
+		NOT_BUILTIN = -1
+	} BuiltInId;
+
+	virtual BuiltInId getBuiltInId() { return NOT_BUILTIN; }
+
 	Type(const std::string& name) : name_(name) {}
 
 	virtual std::string getTypeName() { return name_; }
@@ -336,10 +345,17 @@ public:
 	// implicitly declared variable symbol
 	bool isImplicit;
 
+	// global variable which only the main function refers to (set by EscapeAnalyzer)
+	bool isMainLocal;
+
+	// local array whose elements are allocated on the stack with this capacity,
+	// or 0 if they are allocated by PRMalloc (set by EscapeAnalyzer)
+	int stackCapacity;
+
 	VarSymbol(const std::string& name, Position position)
-		: Symbol(name, position), isImplicit(false) {}
+		: Symbol(name, position), isImplicit(false), isMainLocal(false), stackCapacity(0) {}
 	VarSymbol(const std::string& name, Type *type, Position position)
-		: Symbol(name, type, position), isImplicit(false) {}
+		: Symbol(name, type, position), isImplicit(false), isMainLocal(false), stackCapacity(0) {}
 };
 
 class LabelSymbol : public Symbol {
@@ -351,12 +367,15 @@ public:
 };
 
 class BuiltInTypeSymbol : public Symbol, public Type {
+private:
+	BuiltInId id_;
 public:
 	virtual TypeType getTypeType() { return BUILTIN_TYPE; }
 	virtual SymbolType getSymbolType() { return BUILTIN_TYPE_SYMBOL; }
+	virtual BuiltInId getBuiltInId() { return id_; }
 
-	BuiltInTypeSymbol(const std::string& name)
-		: Symbol(name, 0), Type(name) {}
+	BuiltInTypeSymbol(const std::string& name, BuiltInId id)
+		: Symbol(name, 0), Type(name), id_(id) {}
 };
 
 class ScopedSymbol : public Symbol, public Scope {
@@ -404,17 +423,21 @@ private:
 public:
 	std::vector<Expr *> *defaults;
 
+	// library function which is never referenced (its body is left unresolved)
+	bool isUnused;
+
 	virtual iterator begin() { return iterator(args_.begin()); }
 	virtual iterator end() { return iterator(args_.end()); }
 
 	FuncSymbol(const std::string& name, Scope *parent, Position position)
-		: ScopedSymbol(name, parent, position), defaults(NULL) {}
+		: ScopedSymbol(name, parent, position), defaults(NULL), isUnused(false) {}
 
 	virtual SymbolType getSymbolType() { return FUNC_SYMBOL; }
 
 	virtual Symbol *getMember(const std::string& name) {
-		if (args_.count(name)) {
-			return args_[name];
+		std::map<std::string, Symbol *>::iterator it = args_.find(name);
+		if (it != args_.end()) {
+			return it->second;
 		} else {
 			return NULL;
 		}
@@ -451,8 +474,9 @@ public:
 	virtual iterator end() { return iterator(members_.end()); }
 
 	virtual Symbol *getMember(const std::string& name) {
-		if (members_.count(name)) {
-			return members_[name];
+		std::map<std::string, Symbol *>::iterator it = members_.find(name);
+		if (it != members_.end()) {
+			return it->second;
 		} else {
 			return NULL;
 		}
@@ -470,8 +494,9 @@ public:
 
 	virtual Symbol *resolveMember(const std::string& name, Position curPos = 0) {
 		// allows forward reference
-		if (members_.count(name)/* && members_[name]->getPosition() <= curPos */) {
-			return members_[name];
+		std::map<std::string, Symbol *>::iterator it = members_.find(name);
+		if (it != members_.end()/* && it->second->getPosition() <= curPos */) {
+			return it->second;
 		} else {
 			// don't unwind to the parent scope because it is member
 			return NULL;
@@ -498,15 +523,18 @@ public:
 		return false;
 	}
 
+	// only reads the table so that it can be called from several threads at once
 	virtual Symbol *resolve(const std::string& name, Position curPos = 0) {
-		if (symbols_.count(name) && symbols_[name]->getPosition() <= curPos) {
-			return symbols_[name];
-		} else if (symbols_.count(name) &&
-				(symbols_[name]->getSymbolType() == Symbol::FUNC_SYMBOL ||
-				 symbols_[name]->getSymbolType() == Symbol::CLASS_SYMBOL ||
-				 symbols_[name]->getSymbolType() == Symbol::NAMESPACE_SYMBOL ||
-				 symbols_[name]->getSymbolType() == Symbol::LABEL_SYMBOL)) {
-			return symbols_[name];
+		std::map<std::string, Symbol *>::iterator it = symbols_.find(name);
+		Symbol *symbol = (it != symbols_.end() ? it->second : NULL);
+		if (symbol != NULL && symbol->getPosition() <= curPos) {
+			return symbol;
+		} else if (symbol != NULL &&
+				(symbol->getSymbolType() == Symbol::FUNC_SYMBOL ||
+				 symbol->getSymbolType() == Symbol::CLASS_SYMBOL ||
+				 symbol->getSymbolType() == Symbol::NAMESPACE_SYMBOL ||
+				 symbol->getSymbolType() == Symbol::LABEL_SYMBOL)) {
+			return symbol;
 		} else if (getParentScope() != NULL) {
 			return getParentScope()->resolve(name, curPos);
 		} else {
@@ -546,23 +574,39 @@ private:
 
 	GlobalScope *global_;
 
+	// indexed by Type::BuiltInId
+	BuiltInTypeSymbol *builtIns_[Type::BUILTIN_ID_NUM];
+
 public:
-	BuiltInTypeSymbol *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Void_, *Label_;
+	BuiltInTypeSymbol *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Void_, *Label_, *Int64_;
 
 	SymbolTable() {
 		global_ = new GlobalScope();
 
-		global_->define(Int_	= new BuiltInTypeSymbol("Int"));
-		global_->define(String_ = new BuiltInTypeSymbol("String"));
-		global_->define(Char_	= new BuiltInTypeSymbol("Char"));
-		global_->define(Float_  = new BuiltInTypeSymbol("Float"));
-		global_->define(Double_ = new BuiltInTypeSymbol("Double"));
-		global_->define(Bool_	= new BuiltInTypeSymbol("Bool"));
-		global_->define(Void_	= new BuiltInTypeSymbol("Void"));
-		global_->define(Label_	= new BuiltInTypeSymbol("Label"));
+		global_->define(Int_	= new BuiltInTypeSymbol("Int", Type::INT_ID));
+		global_->define(String_ = new BuiltInTypeSymbol("String", Type::STRING_ID));
+		global_->define(Char_	= new BuiltInTypeSymbol("Char", Type::CHAR_ID));
+		global_->define(Float_  = new BuiltInTypeSymbol("Float", Type::FLOAT_ID));
+		global_->define(Double_ = new BuiltInTypeSymbol("Double", Type::DOUBLE_ID));
+		global_->define(Bool_	= new BuiltInTypeSymbol("Bool", Type::BOOL_ID));
+		global_->define(Void_	= new BuiltInTypeSymbol("Void", Type::VOID_ID));
+		global_->define(Label_	= new BuiltInTypeSymbol("Label", Type::LABEL_ID));
+		global_->define(Int64_	= new BuiltInTypeSymbol("Int64", Type::INT64_ID));
+
+		BuiltInTypeSymbol *builtIns[Type::BUILTIN_ID_NUM] =
+			{ Bool_, Char_, Int_, Float_, Double_, String_, Void_, Label_, Int64_ };
+		for (int i = 0; i < Type::BUILTIN_ID_NUM; ++i) {
+			assert(builtIns[i]->getBuiltInId() == i);
+			builtIns_[i] = builtIns[i];
+		}
 	}
 
 	GlobalScope *getGlobalScope() { return global_; }
+
+	Type *getBuiltInType(Type::BuiltInId id) {
+		assert(0 <= id && id < Type::BUILTIN_ID_NUM);
+		return builtIns_[id];
+	}
 };
 
 }
@@ -41,4 +41,28 @@ std::string Token::toString() const {
 	return str;
 }
 
+Token::BinaryOp Token::getBinaryOp(Type type) {
+	switch (type) {
+	case CARET	: return OP_CARET;
+	case PIPE	: return OP_PIPE;
+	case AMP	: return OP_AMP;
+	case EQL	:
+	case EQEQ	: return OP_EQ;
+	case EXCLEQ	:
+	case EXCL	: return OP_NE;
+	case LT		: return OP_LT;
+	case LTEQ	: return OP_LTEQ;
+	case GT		: return OP_GT;
+	case GTEQ	: return OP_GTEQ;
+	case LTLT	: return OP_LTLT;
+	case GTGT	: return OP_GTGT;
+	case PLUS	: return OP_PLUS;
+	case MINUS	: return OP_MINUS;
+	case STAR	: return OP_STAR;
+	case SLASH	: return OP_SLASH;
+	case PERC	: return OP_PERC;
+	default		: return NOT_BINARY_OP;
+	}
+}
+
 }
@@ -17,6 +17,17 @@ public:
 		PLACEHOLDER
 	} Type;
 
+	// dense ids of the binary operators, which index the operator tables
+	typedef enum {
+		OP_CARET, OP_PIPE, OP_AMP,
+		OP_EQ, OP_NE,
+		OP_LT, OP_LTEQ, OP_GT, OP_GTEQ,
+		OP_LTLT, OP_GTGT,
+		OP_PLUS, OP_MINUS, OP_STAR, OP_SLASH, OP_PERC,
+		BINARY_OP_NUM,
+		NOT_BINARY_OP = -1
+	} BinaryOp;
+
 private:
 	Type type_;
 	Position position_;
@@ -68,6 +79,8 @@ public:
 
 	std::string toString() const;
 
+	static BinaryOp getBinaryOp(Type type);
+
 	Position getPosition() const {
 		return position_;
 	}
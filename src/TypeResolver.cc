@@ -1,6 +1,8 @@
 // For detail, see the top of the SymbolResolver
 
 #include <iostream>
+#include <algorithm>
+#include <thread>
 
 #include "SymbolTable.h"
 #include "TypeResolver.h"
@@ -12,6 +14,7 @@ namespace Peryan {
 
 TypeResolver::TypeResolver(SymbolTable& symbolTable, Options& opt, WarningPrinter& wp)
 	: symbolTable_(symbolTable), opt_(opt), wp_(wp)
+	, unresolved_(false), unresolvedPos_(-1), curTypeVar_(NULL), isWorker_(false)
 	, Int_		(symbolTable_.Int_)
 	, String_	(symbolTable_.String_)
 	, Char_		(symbolTable_.Char_)
@@ -20,10 +23,9 @@ TypeResolver::TypeResolver(SymbolTable& symbolTable, Options& opt, WarningPrinte
 	, Bool_		(symbolTable_.Bool_)
 	, Label_	(symbolTable_.Label_)
 	, Void_		(symbolTable_.Void_)
+	, Int64_	(symbolTable_.Int64_)
+	, curFunc_(NULL)
 	, rewriteWith_(NULL) {
-
-	initPromotionTable();
-	initBinaryPromotionTable();
 }
 
 // check compatibility between two type modifiers (0 means unmodified)
@@ -60,20 +62,28 @@ bool TypeResolver::isSubtypeOf(Type *sub, Type *super) {
 		return true;
 	} else {
 		// Float <: Double
+		// Int <: Int64
 		if (sub->is(Float_) && super->is(Double_)) {
 			return true;
+		} else if (sub->is(Int_) && super->is(Int64_)) {
+			return true;
 		} else {
 			return false;
 		}
 	}
 }
 
+// lengths and subscripts of arrays
+bool TypeResolver::isIndexType(Type *type) {
+	return type->unmodify()->is(Int_) || type->unmodify()->is(Int64_);
+}
+
 bool TypeResolver::canPromote(Type *from, Type *to, Position pos, bool isFuncParam) {
 	assert(from != NULL && to != NULL);
 
 	if (isSubtypeOf(/*sub = */ from->unmodify(), /*super = */ to->unmodify())) {
 		// correct
-	} else if (opt_.hspCompat && promotionTable.count(PromotionKey(from->unmodify(), to->unmodify())) > 0) {
+	} else if (opt_.hspCompat && isPromotable(from->unmodify(), to->unmodify())) {
 		// explicit type conversion is always prohibited in Peryan mode
 		wp_.add(pos, "warning: implicit conversion from Int to Double is deprecated");
 	} else {
@@ -84,16 +94,6 @@ bool TypeResolver::canPromote(Type *from, Type *to, Position pos, bool isFuncPar
 	return canConvertModifier(from, to, isFuncParam);
 }
 
-Type *TypeResolver::canPromoteBinary(Type *lhsType, Token::Type tokenType, Type* rhsType) {
-	BinaryPromotionKey key(lhsType, tokenType, rhsType);
-
-	if (binaryPromotionTable.count(key)) {
-		return binaryPromotionTable[key];
-	} else {
-		return NULL;
-	}
-}
-
 Expr *TypeResolver::insertPromoter(Expr *from, Type *toType) {
 	assert(from != NULL);
 	assert(from->type != NULL);
@@ -136,188 +136,206 @@ Expr *TypeResolver::insertPromoter(Expr *from, Type *toType) {
 	// TODO: copy ArrayType?
 }
 
-void TypeResolver::initPromotionTable() {
-	Type *types[8] = { Bool_, Char_, Int_, Float_, Double_, String_, Void_, Label_ };
-	bool table[8][8] = {
-		/*frm\to	  Bool	  Char	  Int	  Float	  Double  String  Void    Label */
-		/* Bool   */	{ true	, true	, true	, true	, true	, false	, false	, false	},
-		/* Char   */	{ true	, true	, true	, true	, true	, false	, false	, false	},
-		/* Int	  */	{ true	, true	, true	, true	, true	, true  , false	, false	},
-		/* Float  */	{ false , false	, false	, true	, false	, false	, false	, false	},
-		/* Double */	{ false	, false	, true	, false	, true	, false	, false	, false	},
-		/* String */	{ false	, false	, true  , false	, false	, true	, false	, false	},
-		/* Void   */	{ false	, false	, false	, false	, false	, false	, true	, false	},
-		/* Label  */	{ false	, false	, false	, false	, false	, false	, false	, true	}
-	};
-
-	for (int iFrom = 0; iFrom < 8; ++iFrom)
-	for (int iTo = 0; iTo < 8; ++iTo)
-		if (table[iFrom][iTo] == true)
-			promotionTable.insert(PromotionKey(types[iFrom], types[iTo]));
+// indexed by Type::BuiltInId
+static const bool promotionTable[Type::BUILTIN_ID_NUM][Type::BUILTIN_ID_NUM] = {
+	/*frm\to	  Bool	  Char	  Int	  Float	  Double  String  Void    Label   Int64 */
+	/* Bool   */	{ true	, true	, true	, true	, true	, false	, false	, false	, true	},
+	/* Char   */	{ true	, true	, true	, true	, true	, false	, false	, false	, true	},
+	/* Int	  */	{ true	, true	, true	, true	, true	, true  , false	, false	, true	},
+	/* Float  */	{ false , false	, true	, true	, false	, false	, false	, false	, true	},
+	/* Double */	{ false	, false	, true	, false	, true	, false	, false	, false	, true	},
+	/* String */	{ false	, false	, true  , false	, false	, true	, false	, false	, false	},
+	/* Void   */	{ false	, false	, false	, false	, false	, false	, true	, false	, false	},
+	/* Label  */	{ false	, false	, false	, false	, false	, false	, false	, true	, false	},
+	/* Int64  */	{ true	, true	, true	, true	, true	, true	, false	, false	, true	}
+};
+
+bool TypeResolver::isPromotable(Type *from, Type *to) {
+	const Type::BuiltInId fromId = from->getBuiltInId();
+	const Type::BuiltInId toId = to->getBuiltInId();
+
+	if (fromId == Type::NOT_BUILTIN || toId == Type::NOT_BUILTIN)
+		return false;
 
-	return;
+	return promotionTable[fromId][toId];
 }
 
-#define REGISTER_BINARY_PROMOTION(TABLE, TOKEN_TYPES) \
-	for (int iLhs = 1; iLhs < 9; ++iLhs) \
-	for (int iRhs = 1; iRhs < 9; ++iRhs) \
-	for (unsigned int iToken = 0; iToken < sizeof(TOKEN_TYPES) / sizeof(TOKEN_TYPES[0]); ++iToken) \
-		if (TABLE[iLhs][iRhs] != NULL) \
-			binaryPromotionTable[\
-				BinaryPromotionKey(TABLE[iLhs][0], TOKEN_TYPES[iToken], TABLE[0][iRhs])] \
-					= TABLE[iLhs][iRhs];
-
-void TypeResolver::initBinaryPromotionTable() {
-	// ^ | &
-	Token::Type caretPipeAmpTokenTypes[] = { Token::CARET, Token::PIPE, Token::AMP };
-	Type *caretPipeAmp[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , Bool_	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, Int_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-	REGISTER_BINARY_PROMOTION(caretPipeAmp, caretPipeAmpTokenTypes);
-
-	// = == != !
-	Token::Type eqlEqeqExcleqExclTokenTypes[] = { Token::EQL, Token::EQEQ, Token::EXCLEQ, Token::EXCL};
-	Type *eqlEqeqExcleqExcl[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , Bool_	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, Bool_	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, Bool_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, Bool_	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, Bool_	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , Bool_  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , Bool_ , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , Bool_  }
-	};
-	REGISTER_BINARY_PROMOTION(eqlEqeqExcleqExcl, eqlEqeqExcleqExclTokenTypes);
-
-	// < <= > >=
-	Token::Type ltLteqGtGteqTokenTypes[] = { Token::LT, Token::LTEQ, Token::GT, Token::GTEQ };
-	Type *ltLteqGtGteq[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, Bool_	, Bool_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, Bool_	, Bool_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, Bool_	, Bool_	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, Bool_	, Bool_	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-	REGISTER_BINARY_PROMOTION(ltLteqGtGteq, ltLteqGtGteqTokenTypes);
-
-	// << >>
-	// Token::LTLT Token::GTGT
-	Token::Type ltltGtgtTokenTypes[] = { Token::LTLT, Token::GTGT };
-	Type *ltltGtgt[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, Int_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-	REGISTER_BINARY_PROMOTION(ltltGtgt, ltltGtgtTokenTypes);
-
-	// + - * / 
-
-	Token::Type plusMinusStarSlashTokenTypes[] = { Token::PLUS, Token::MINUS, Token::STAR, Token::SLASH };
-	Type *plusMinusStarSlash[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, Char_	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, Int_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, Float_, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, Double_, NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-
-	Type *hspCompatPlusMinusStarSlash[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , Int_	, Int_	, Int_	, Int_	, Int_	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, Char_	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, Int_	, Int_	, Int_	, Int_	, Int_	 , NULL	  , NULL  , NULL   },
-		{ Float_, Float_, Float_, Float_, Float_, Double_, NULL	  , NULL  , NULL   },
-		{ Double_,Double_,Double_,Double_,Double_,Double_, NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-	if (opt_.hspCompat) {
-		REGISTER_BINARY_PROMOTION(hspCompatPlusMinusStarSlash, plusMinusStarSlashTokenTypes);
-	} else {
-		REGISTER_BINARY_PROMOTION(plusMinusStarSlash, plusMinusStarSlashTokenTypes);
-	}
-
-	// %
-	Token::Type percTokenTypes[] = { Token::PERC };
-	Type *perc[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, Int_	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-	REGISTER_BINARY_PROMOTION(perc, percTokenTypes);
-
-	// + for String
-	Token::Type stringPlusTokenTypes[] = { Token::PLUS };
-	Type *stringPlus[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, NULL  ,NULL	, NULL	 , String_, NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-
-	Type *hspCompatStringPlus[9][9] = {
-		/*lhs\rhs*/
-		{ NULL	, Bool_ , Char_ , Int_	, Float_, Double_, String_, Void_ , Label_ },
-		{ Bool_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Char_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Int_	, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Float_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Double_,NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ String_,NULL	, NULL	, String_,NULL	, NULL	 , String_, NULL  , NULL   },
-		{ Void_ , NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   },
-		{ Label_, NULL	, NULL	, NULL	, NULL	, NULL	 , NULL	  , NULL  , NULL   }
-	};
-
-	if (opt_.hspCompat) {
-		REGISTER_BINARY_PROMOTION(hspCompatStringPlus, stringPlusTokenTypes);
-	} else {
-		REGISTER_BINARY_PROMOTION(stringPlus, stringPlusTokenTypes);
-	}
+// the entries of the operator tables are the ids of the result types plus one,
+// so that the missing entries (R_NONE) are not allowed
+enum BinaryResult {
+	R_NONE	= 0,
+	R_BOOL	= Type::BOOL_ID + 1,
+	R_CHAR	= Type::CHAR_ID + 1,
+	R_INT	= Type::INT_ID + 1,
+	R_FLOAT	= Type::FLOAT_ID + 1,
+	R_DOUBLE= Type::DOUBLE_ID + 1,
+	R_STRING= Type::STRING_ID + 1,
+	R_VOID	= Type::VOID_ID + 1,
+	R_LABEL	= Type::LABEL_ID + 1,
+	R_INT64	= Type::INT64_ID + 1
+};
+
+typedef BinaryResult BinaryPromotion[Type::BUILTIN_ID_NUM][Type::BUILTIN_ID_NUM];
+
+// ^ | &
+static const BinaryPromotion caretPipeAmp = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// = == != !
+static const BinaryPromotion eqlEqeqExcleqExcl = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL }
+};
+
+// < <= > >=
+static const BinaryPromotion ltLteqGtGteq = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_BOOL,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_BOOL,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_BOOL,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_BOOL,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_BOOL }
+};
+
+// << >>
+static const BinaryPromotion ltltGtgt = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// - * /
+static const BinaryPromotion minusStarSlash = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_CHAR,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_FLOAT,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// +
+static const BinaryPromotion plus = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_CHAR,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_FLOAT,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_STRING, R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// %
+static const BinaryPromotion perc = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_NONE,   R_NONE,   R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Double */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_NONE,   R_NONE,   R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// - * / (in HSP compatible mode, the type of the left hand side wins)
+static const BinaryPromotion hspCompatMinusStarSlash = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_INT,    R_INT,    R_INT,    R_INT,    R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_CHAR,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_INT,    R_INT,    R_INT,    R_INT,    R_INT,    R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_FLOAT,  R_FLOAT,  R_FLOAT,  R_FLOAT,  R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_FLOAT },
+	/* Double */	{ R_DOUBLE, R_DOUBLE, R_DOUBLE, R_DOUBLE, R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_DOUBLE },
+	/* String */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_INT64,  R_INT64,  R_INT64,  R_INT64,  R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// + (in HSP compatible mode, the type of the left hand side wins)
+static const BinaryPromotion hspCompatPlus = {
+	/*lhs\rhs	  Bool      Char      Int       Float     Double    String    Void      Label     Int64 */
+	/* Bool   */	{ R_INT,    R_INT,    R_INT,    R_INT,    R_INT,    R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Char   */	{ R_NONE,   R_CHAR,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int    */	{ R_INT,    R_INT,    R_INT,    R_INT,    R_INT,    R_NONE,   R_NONE,   R_NONE,   R_INT64 },
+	/* Float  */	{ R_FLOAT,  R_FLOAT,  R_FLOAT,  R_FLOAT,  R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_FLOAT },
+	/* Double */	{ R_DOUBLE, R_DOUBLE, R_DOUBLE, R_DOUBLE, R_DOUBLE, R_NONE,   R_NONE,   R_NONE,   R_DOUBLE },
+	/* String */	{ R_NONE,   R_NONE,   R_STRING, R_NONE,   R_NONE,   R_STRING, R_NONE,   R_NONE,   R_STRING },
+	/* Void   */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Label  */	{ R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE,   R_NONE },
+	/* Int64  */	{ R_INT64,  R_INT64,  R_INT64,  R_INT64,  R_INT64,  R_NONE,   R_NONE,   R_NONE,   R_INT64 }
+};
+
+// indexed by Token::BinaryOp, so typing a binary operator costs one lookup
+static const BinaryPromotion *const binaryPromotionTable[Token::BINARY_OP_NUM] = {
+	/* ^ | &    */	&caretPipeAmp, &caretPipeAmp, &caretPipeAmp,
+	/* == !=    */	&eqlEqeqExcleqExcl, &eqlEqeqExcleqExcl,
+	/* < <= > >=*/	&ltLteqGtGteq, &ltLteqGtGteq, &ltLteqGtGteq, &ltLteqGtGteq,
+	/* << >>    */	&ltltGtgt, &ltltGtgt,
+	/* + - * /  */	&plus, &minusStarSlash, &minusStarSlash, &minusStarSlash,
+	/* %        */	&perc
+};
+
+static const BinaryPromotion *const hspCompatBinaryPromotionTable[Token::BINARY_OP_NUM] = {
+	/* ^ | &    */	&caretPipeAmp, &caretPipeAmp, &caretPipeAmp,
+	/* == !=    */	&eqlEqeqExcleqExcl, &eqlEqeqExcleqExcl,
+	/* < <= > >=*/	&ltLteqGtGteq, &ltLteqGtGteq, &ltLteqGtGteq, &ltLteqGtGteq,
+	/* << >>    */	&ltltGtgt, &ltltGtgt,
+	/* + - * /  */	&hspCompatPlus, &hspCompatMinusStarSlash, &hspCompatMinusStarSlash, &hspCompatMinusStarSlash,
+	/* %        */	&perc
+};
 
-	return;
+Type *TypeResolver::canPromoteBinary(Type *lhsType, Token::Type tokenType, Type* rhsType) {
+	const Token::BinaryOp op = Token::getBinaryOp(tokenType);
+	const Type::BuiltInId lhsId = lhsType->getBuiltInId();
+	const Type::BuiltInId rhsId = rhsType->getBuiltInId();
+
+	if (op == Token::NOT_BINARY_OP || lhsId == Type::NOT_BUILTIN || rhsId == Type::NOT_BUILTIN)
+		return NULL;
+
+	const BinaryResult result = (*(opt_.hspCompat ? hspCompatBinaryPromotionTable
+						      : binaryPromotionTable)[op])[lhsId][rhsId];
+	if (result == R_NONE)
+		return NULL;
+
+	return symbolTable_.getBuiltInType(static_cast<Type::BuiltInId>(result - 1));
 }
 
 void TypeResolver::addTypeConstraint(Type *constraint, TypeVar typeVar) {
@@ -350,6 +368,135 @@ void TypeResolver::addTypeConstraint(Type *constraint, TypeVar typeVar) {
 	return;
 }
 
+void TypeResolver::mergeTypeConstraint(TypeVar typeVar, const TypeConstraint& constraint) {
+	addTypeConstraint(constraint.lowerBound, typeVar);
+	if (constraint.upperBound != NULL) {
+		addTypeConstraint(constraint.upperBound, typeVar);
+	}
+	if (!constraint.takeLowerBound) {
+		constraints_[typeVar].takeLowerBound = false;
+	}
+
+	return;
+}
+
+// Type variables are only assigned between the attempts, so within an attempt
+// each function body can be checked on its own thread with its own constraints,
+// which are merged afterwards. HSP compatible mode assigns some of them in the middle
+// of an attempt, so it is always checked in order.
+bool TypeResolver::shouldDeferBodies() {
+	return !isWorker_ && opt_.jobs > 1 && !opt_.hspCompat;
+}
+
+void TypeResolver::resolvePendingBodies() {
+	if (pendingBodies_.empty())
+		return;
+
+	const int jobs = std::min(opt_.jobs, static_cast<int>(pendingBodies_.size()));
+
+	std::vector<WarningPrinter *> wps;
+	std::vector<TypeResolver *> workers;
+	for (int i = 0; i < jobs; ++i) {
+		wps.push_back(new WarningPrinter());
+		workers.push_back(new TypeResolver(symbolTable_, opt_, *wps.back()));
+		workers.back()->isWorker_ = true;
+		workers.back()->sharedDefaults_ = sharedDefaults_;
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < jobs; ++i) {
+		threads.push_back(std::thread(&TypeResolver::resolveBodies, workers[i], &pendingBodies_, i, jobs));
+	}
+	for (int i = 0; i < jobs; ++i) {
+		threads[i].join();
+	}
+
+	wp_.merge(wps);
+
+	std::vector<SemanticsError> errors;
+	for (int i = 0; i < jobs; ++i) {
+		TypeResolver *worker = workers[i];
+
+		if (worker->unresolved_) {
+			unresolved_ = true;
+			unresolvedPos_ = std::max(unresolvedPos_, worker->unresolvedPos_);
+		}
+
+		for (std::map<TypeVar, TypeConstraint>::iterator it = worker->constraints_.begin();
+				it != worker->constraints_.end(); ++it) {
+			mergeTypeConstraint(it->first, it->second);
+		}
+
+		errors.insert(errors.end(), worker->errors_.begin(), worker->errors_.end());
+
+		delete worker;
+		delete wps[i];
+	}
+
+	pendingBodies_.clear();
+
+	// report the error which appears first in the source
+	if (!errors.empty()) {
+		SemanticsError *first = &errors[0];
+		for (std::vector<SemanticsError>::iterator it = errors.begin(); it != errors.end(); ++it) {
+			if (it->getPosition() < first->getPosition())
+				first = &(*it);
+		}
+		throw *first;
+	}
+
+	return;
+}
+
+// runs on a worker thread and checks bodies[first], bodies[first + step], ...
+void TypeResolver::resolveBodies(std::vector<FuncDefStmt *> *bodies, int first, int step) {
+	for (int i = first; i < static_cast<int>(bodies->size()); i += step) {
+		curFunc_ = NULL;
+		curTypeVar_ = NULL;
+		try {
+			(*bodies)[i]->accept(this);
+		} catch (SemanticsError& se) {
+			errors_.push_back(se);
+			return;
+		}
+	}
+
+	return;
+}
+
+// The default arguments are shared by all the call sites, which may be checked on
+// different threads, so with deferred bodies they are resolved and promoted to
+// the parameter types once here, and the workers only read them.
+void TypeResolver::resolveDefaults(std::vector<Expr *>& defaults, FuncType *funcType) {
+	std::vector<Expr *>::iterator defIt = defaults.begin();
+	FuncType::iterator ftIt = funcType->begin(Void_);
+
+	for ( ; defIt != defaults.end() && ftIt != funcType->end(); ++defIt, ++ftIt) {
+		if (*defIt == NULL)
+			continue;
+
+		curTypeVar_ = NULL;
+		(*defIt)->accept(this);
+		*defIt = refresh(*defIt);
+		sharedDefaults_.insert(*defIt);
+
+		Type *actual = (*defIt)->type;
+
+		if (actual == NULL) {
+			assert(unresolved_);
+			if (curTypeVar_ != NULL && *ftIt != NULL)
+				addTypeConstraint((*ftIt)->unmodify(), curTypeVar_);
+		} else if (*ftIt != NULL && canPromote(actual, *ftIt, (*defIt)->token.getPosition(), true)) {
+			*defIt = insertPromoter(*defIt, *ftIt);
+			sharedDefaults_.insert(*defIt);
+		}
+
+		curTypeVar_ = NULL;
+	}
+
+	return;
+}
+
 void TypeResolver::visit(TransUnit *tu) {
 	assert(tu != NULL);
 
@@ -368,6 +515,8 @@ void TypeResolver::visit(TransUnit *tu) {
 		for (std::vector<Stmt *>::iterator it = tu->stmts.begin(); it != tu->stmts.end(); ++it) {
 			(*it)->accept(this);
 		}
+
+		resolvePendingBodies();
 		
 		if (!unresolved_)
 			break;
@@ -435,6 +584,16 @@ void TypeResolver::visit(FuncDefStmt *fds) {
 	assert(fds->symbol->getType() != NULL);
 	assert(fds->symbol->getType()->getTypeType() == Type::FUNC_TYPE);
 
+	// the body wasn't resolved by SymbolResolver since nothing refers to the function
+	if (fds->symbol->isUnused)
+		return;
+
+	if (shouldDeferBodies()) {
+		resolveDefaults(fds->defaults, static_cast<FuncType *>(fds->symbol->getType()));
+		pendingBodies_.push_back(fds);
+		return;
+	}
+
 	FuncSymbol *prevFunc_ = curFunc_;
 
 	curFunc_ = static_cast<FuncSymbol *>(fds->symbol);
@@ -472,6 +631,17 @@ void TypeResolver::visit(FuncDefStmt *fds) {
 	return;
 }
 
+void TypeResolver::visit(ExternStmt *es) {
+	assert(es != NULL);
+	assert(es->id->type != NULL);
+
+	if (shouldDeferBodies() && es->id->type->unmodify()->getTypeType() == Type::FUNC_TYPE) {
+		resolveDefaults(es->defaults, static_cast<FuncType *>(es->id->type->unmodify()));
+	}
+
+	return;
+}
+
 void TypeResolver::visit(VarDefStmt *vds) {
 	assert(vds != NULL);
 	assert(vds->id != NULL);
@@ -621,6 +791,7 @@ void TypeResolver::visit(AssignStmt *as) {
 	}
 
 	if (!(lhsType->unmodify()->is(Int_)) && !(lhsType->unmodify()->is(Char_))
+			&& !(lhsType->unmodify()->is(Int64_))
 			&& !(lhsType->unmodify()->is(Float_)) && !(lhsType->unmodify()->is(Double_))
 			&& as->token.getType() != Token::EQL
 			&&! (as->token.getType() == Token::PLUSEQ && lhsType->unmodify()->is(String_))) {
@@ -642,7 +813,8 @@ void TypeResolver::visit(AssignStmt *as) {
 	switch (as->token.getType()) {
 	case Token::PLUSPLUS:
 	case Token::MINUSMINUS:
-		if (!(lhsType->unmodify()->is(Int_)) && !(lhsType->unmodify()->is(Char_)))
+		if (!(lhsType->unmodify()->is(Int_)) && !(lhsType->unmodify()->is(Char_))
+				&& !(lhsType->unmodify()->is(Int64_)))
 			throw SemanticsError(as->token.getPosition(),
 				std::string("error: left hand side (")
 				+ lhsType->getTypeName()
@@ -741,9 +913,15 @@ void TypeResolver::visit(RepeatStmt *rs) {
 			}
 			return;
 		}
-		if (!canPromote(cur, Int_, rs->count->token.getPosition(), false))
-			throw SemanticsError(rs->token.getPosition(), "error: repeat counter should be Int");
-		rs->count = insertPromoter(rs->count, Int_);
+		if (cur->unmodify()->is(Int64_)) {
+			// the counter is as wide as the count
+			rs->count = insertPromoter(rs->count, Int64_);
+			rs->scope->resolve("cnt", rs->token.getPosition())->setType(Int64_);
+		} else {
+			if (!canPromote(cur, Int_, rs->count->token.getPosition(), false))
+				throw SemanticsError(rs->token.getPosition(), "error: repeat counter should be Int");
+			rs->count = insertPromoter(rs->count, Int_);
+		}
 	}
 
 	for (std::vector<Stmt *>::iterator it = rs->stmts.begin();
@@ -901,13 +1079,17 @@ void TypeResolver::visit(BinaryExpr *be) {
 		assert(be->rhs != NULL);
 		assert(be->rhs->type != NULL);
 
-		if (lhsType->is(lhsType->unmodify()) && rhsType->is(rhsType->unmodify())) {
+		// the narrower side is always widened (e.g. Int to Int64)
+		const bool widens = !lhsType->unmodify()->is(rhsType->unmodify())
+			&& (isSubtypeOf(lhsType, rhsType) || isSubtypeOf(rhsType, lhsType));
+
+		if (lhsType->is(lhsType->unmodify()) && rhsType->is(rhsType->unmodify()) && !widens) {
 			be->type = new ModifierType(true, false, be->type);
 			return;
 		}
 
-		// in HSP, the rhs is always casted to the lhs type
-		if (!opt_.hspCompat && canPromote(lhsType, rhsType->unmodify(),
+		// in HSP, the rhs is always casted to the lhs type unless it is widened
+		if ((widens ? isSubtypeOf(lhsType, rhsType) : !opt_.hspCompat) && canPromote(lhsType, rhsType->unmodify(),
 					be->lhs->token.getPosition(), false)) {
 			// rhsType->unmodify() is wider than lhsType->unmodify().
 			be->lhs = insertPromoter(be->lhs, rhsType->unmodify());
@@ -952,7 +1134,8 @@ void TypeResolver::visit(UnaryExpr *ue) {
 	case Token::PLUS:
 	case Token::MINUS:
 		if (!(rhsType->unmodify()->is(Int_)) && !(rhsType->unmodify()->is(Float_))
-			&& !(rhsType->unmodify()->is(Double_)) && !(rhsType->unmodify()->is(Char_)))
+			&& !(rhsType->unmodify()->is(Double_)) && !(rhsType->unmodify()->is(Char_))
+			&& !(rhsType->unmodify()->is(Int64_)))
 			throw SemanticsError(ue->token.getPosition(), "error: right side should be numeric type");
 
 		ue->rhs = insertPromoter(ue->rhs, rhsType->unmodify());
@@ -1113,6 +1296,8 @@ void TypeResolver::visit(FuncCallExpr *fce) {
 	FuncType::iterator ftIt = curFuncType->begin(Void_), ftEnd = curFuncType->end();
 
 	while (prmIt != fce->params.end() || ftIt != ftEnd) {
+		bool isDefault = false;
+
 		if (prmIt != fce->params.end() && ftIt == ftEnd) {
 			// given parameters > parameters in the type
 			throw SemanticsError((*prmIt)->token.getPosition(),
@@ -1124,6 +1309,7 @@ void TypeResolver::visit(FuncCallExpr *fce) {
 				// the default value exists
 				fce->params.push_back(*defIt);
 				prmIt = fce->params.end() - 1; // be careful that push_back may invalidate iterators
+				isDefault = true;
 			} else {
 				throw SemanticsError(fce->token.getPosition(),
 						"error: fewer arguments in the function call");
@@ -1136,6 +1322,7 @@ void TypeResolver::visit(FuncCallExpr *fce) {
 				// the default value exists
 				if (defIt != defaults.end() && *defIt != NULL) {
 					*prmIt = *defIt;
+					isDefault = true;
 				} else {
 					std::stringstream ss;
 					ss<<"error: you cannot omit ";
@@ -1145,8 +1332,20 @@ void TypeResolver::visit(FuncCallExpr *fce) {
 			}
 		}
 
-		(*prmIt)->accept(this);
-		*prmIt = refresh(*prmIt);
+		if (isWorker_ && (isDefault || sharedDefaults_.count(*prmIt))) {
+			// shared with the other threads, and already resolved by resolveDefaults()
+			// (the call site may still hold the default of the previous attempt)
+			assert(defIt != defaults.end() && *defIt != NULL);
+			*prmIt = *defIt;
+			curTypeVar_ = NULL;
+			if ((*prmIt)->type == NULL) {
+				unresolved_ = true;
+				unresolvedPos_ = (*prmIt)->token.getPosition();
+			}
+		} else {
+			(*prmIt)->accept(this);
+			*prmIt = refresh(*prmIt);
+		}
 
 		Type *actual = (*prmIt)->type;
 
@@ -1240,21 +1439,21 @@ void TypeResolver::visit(ConstructorExpr *ce) {
 		// TODO: add optimization there from LLVMCodeGen and check the type
 	} else if (ce->params.size() == 1 &&
 			ce->type->getTypeType() == Type::BUILTIN_TYPE &&
-			promotionTable.count(PromotionKey(ce->params[0]->type->unmodify(), ce->type)) > 0) {
+			isPromotable(ce->params[0]->type->unmodify(), ce->type)) {
 		// TypeA(TypeB) where TypeB can promote to TypeA
 		ce->params[0] = insertPromoter(ce->params[0], ce->params[0]->type->unmodify());
 	} else if (ce->params.size() == 1 &&
 			ce->type->getTypeType() == Type::ARRAY_TYPE &&
-			ce->params[0]->type->unmodify()->is(Int_)) {
+			isIndexType(ce->params[0]->type)) {
 		// [Type](length)
-		ce->params[0] = insertPromoter(ce->params[0], Int_);
+		ce->params[0] = insertPromoter(ce->params[0], ce->params[0]->type->unmodify());
 	} else if (ce->params.size() == 2 &&
 			ce->type->getTypeType() == Type::ARRAY_TYPE &&
-			ce->params[0]->type->unmodify()->is(Int_) &&
+			isIndexType(ce->params[0]->type) &&
 			ce->params[1]->type->unmodify()->is(
 				static_cast<ArrayType *>(ce->type)->getElemType()->unmodify())) {
 		// [Type](length, initializer)
-		ce->params[0] = insertPromoter(ce->params[0], Int_);
+		ce->params[0] = insertPromoter(ce->params[0], ce->params[0]->type->unmodify());
 		ce->params[1] = insertPromoter(ce->params[1],
 					static_cast<ArrayType *>(ce->type)->getElemType()->unmodify());
 	} else {
@@ -1340,10 +1539,10 @@ void TypeResolver::visit(SubscrExpr *se) {
 		se->type = NULL;
 		return;
 	}
-	if (!(subscriptType->unmodify()->is(Int_)))
-		throw SemanticsError(se->token.getPosition(), "error: subscript should be Int");
+	if (!isIndexType(subscriptType))
+		throw SemanticsError(se->token.getPosition(), "error: subscript should be Int or Int64");
 
-	se->subscript = insertPromoter(se->subscript, Int_);
+	se->subscript = insertPromoter(se->subscript, subscriptType->unmodify());
 
 	se->type = static_cast<ArrayType *>(arrayType->unmodify())->getElemType();
 
@@ -1404,10 +1603,36 @@ void TypeResolver::visit(MemberExpr *me) {
 				+ "\" for type " + me->receiver->type->getTypeName());
 		}
 	} else if (me->receiver->type->unmodify()->getTypeType() == Type::ARRAY_TYPE) {
-		if (me->member->getString() == "length") {
-			me->type = new ModifierType(true, true, Int_);
-		} else if (me->member->getString() == "resize") {
-			me->type = new FuncType(Int_, Void_);
+		Type *elemType = static_cast<ArrayType *>(me->receiver->type->unmodify())->getElemType();
+		const std::string& member = me->member->getString();
+
+		if (me->receiver->type->isConst()
+			&& (member == "resize" || member == "reserve" || member == "push"
+			|| member == "pop" || member == "insert" || member == "remove")) {
+			throw SemanticsError(me->token.getPosition(),
+				std::string("error: cannot modify constant array by \"") + member + "\"");
+		}
+
+		if (member == "length") {
+			// the length is 64-bit, so it is truncated to Int
+			me->type = new ModifierType(true, false, Int_);
+		} else if (member == "longLength") {
+			me->type = new ModifierType(true, false, Int64_);
+		} else if (member == "resize" || member == "reserve") {
+			// resize, reserve :: Int64 -> Void
+			me->type = new FuncType(Int64_, Void_);
+		} else if (member == "push") {
+			// push :: Type -> Void
+			me->type = new FuncType(elemType, Void_);
+		} else if (member == "pop") {
+			// pop :: Void -> Type
+			me->type = new FuncType(Void_, elemType);
+		} else if (member == "insert") {
+			// insert :: Int64 -> Type -> Void
+			me->type = new FuncType(Int64_, new FuncType(elemType, Void_));
+		} else if (member == "remove") {
+			// remove :: Int64 -> Void
+			me->type = new FuncType(Int64_, Void_);
 		} else {
 			if (opt_.hspCompat) {
 				// rewrite the whole expression as an array reference
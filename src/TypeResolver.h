@@ -3,6 +3,7 @@
 
 #include <set>
 #include <map>
+#include <vector>
 
 #include "SymbolTable.h"
 #include "Token.h"
@@ -44,9 +45,24 @@ private:
 	std::set<TypeVar> incomplete_;
 	TypeVar curTypeVar_;
 	void addTypeConstraint(Type *constraint, TypeVar typeVar);
+	void mergeTypeConstraint(TypeVar typeVar, const TypeConstraint& constraint);
 
+	// function bodies checked on worker threads in each attempt (if --jobs is given)
+	std::vector<FuncDefStmt *> pendingBodies_;
 
-	Type *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Label_, *Void_;
+	// true for resolvers running on worker threads
+	bool isWorker_;
+	std::vector<SemanticsError> errors_;
+
+	bool shouldDeferBodies();
+	void resolvePendingBodies();
+	void resolveBodies(std::vector<FuncDefStmt *> *bodies, int first, int step);
+	// default arguments resolved by resolveDefaults(), which the workers must not visit
+	std::set<Expr *> sharedDefaults_;
+	void resolveDefaults(std::vector<Expr *>& defaults, FuncType *funcType);
+
+
+	Type *Int_, *String_, *Char_, *Float_, *Double_, *Bool_, *Label_, *Void_, *Int64_;
 
 	FuncSymbol *curFunc_;
 
@@ -55,50 +71,11 @@ private:
 
 	bool canConvertModifier(Type *from, Type *to, bool isFuncParam = false);
 	bool isSubtypeOf(Type *sub, Type *super);
+	bool isIndexType(Type *type);
 
 	Expr *insertPromoter(Expr *from, Type *toType);
 
-	class PromotionKey {
-	public:
-		Type *from, *to;
-		PromotionKey(Type *from, Type *to) : from(from), to(to) {}
-
-		bool operator<(const PromotionKey& p) const {
-			if (from != p.from) {
-				return from < p.from;
-			} else {
-				return to < p.to;
-			}
-		}
-	};
-
-	class BinaryPromotionKey {
-	public:
-		Type *from, *to;
-		Token::Type type;
-		BinaryPromotionKey(Type *from, Token::Type type, Type *to)
-			: from(from), to(to), type(type) {}
-
-		// it seems verbose but I think it's better than doing it with hard-reading way
-		bool operator<(const BinaryPromotionKey& p) const {
-			if (from != p.from) {
-				return from < p.from;
-			} else {
-				if (type != p.type) {
-					return type < p.type;
-				} else {
-					return to < p.to;
-				}
-			}
-		}
-	};
-
-	std::set<PromotionKey> promotionTable;
-	std::map<BinaryPromotionKey, Type *> binaryPromotionTable;
-
-	void initPromotionTable();
-
-	void initBinaryPromotionTable();
+	bool isPromotable(Type *from, Type *to);
 
 	Expr *rewriteWith_;
 	Expr *refresh(Expr *from) {
@@ -118,6 +95,7 @@ public:
 	TypeResolver(SymbolTable& symbolTable, Options& opt, WarningPrinter& wp);
 	virtual void visit(TransUnit *tu);
 	virtual void visit(FuncDefStmt *fds);
+	virtual void visit(ExternStmt *es);
 	virtual void visit(VarDefStmt *vds);
 	virtual void visit(AssignStmt *as);
 	virtual void visit(CompStmt *cs);
@@ -146,7 +124,6 @@ public:
 	virtual void visit(RefExpr *re);
 
 	virtual void visit(LabelStmt *ls)	{ return; }
-	virtual void visit(ExternStmt *es)	{ return; }
 	virtual void visit(ContinueStmt *cs)	{ return; }
 	virtual void visit(BreakStmt *bs)	{ return; }
 	virtual void visit(TypeSpec *ts)	{ return; }
@@ -3,6 +3,23 @@
 
 namespace Peryan {
 
+static bool comparePosition(const std::pair<Position, std::string>& lhs,
+				const std::pair<Position, std::string>& rhs) {
+	return lhs.first < rhs.first;
+}
+
+void WarningPrinter::merge(const std::vector<WarningPrinter *>& others) {
+	std::vector<std::pair<Position, std::string> > merged;
+	for (std::vector<WarningPrinter *>::const_iterator it = others.begin(); it != others.end(); ++it) {
+		merged.insert(merged.end(), (*it)->warnings_.begin(), (*it)->warnings_.end());
+	}
+
+	std::stable_sort(merged.begin(), merged.end(), comparePosition);
+
+	warnings_.insert(warnings_.end(), merged.begin(), merged.end());
+	return;
+}
+
 void WarningPrinter::print(Lexer& lexer) {
 	for (std::vector<std::pair<Position, std::string> >::iterator it = warnings_.begin();
 			it != warnings_.end(); ++it) {
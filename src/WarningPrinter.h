@@ -20,6 +20,9 @@ public:
 		return;
 	}
 
+	// append warnings collected separately (ex. on other threads) in the order of their positions
+	void merge(const std::vector<WarningPrinter *>& others);
+
 	void print(Lexer& lexer);
 };
 
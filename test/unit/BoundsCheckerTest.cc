@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+
+#include "../../src/WarningPrinter.h"
+#include "../../src/Options.h"
+#include "../../src/Lexer.h"
+#include "../../src/Parser.h"
+#include "../../src/StringSourceReader.h"
+#include "../../src/AST.h"
+#include "../../src/BoundsChecker.h"
+
+namespace {
+
+class BoundsCheckerTest : public ::testing::Test {
+protected:
+	Peryan::Options opt;
+	Peryan::StringSourceReader ssr;
+	Peryan::WarningPrinter wp;
+	Peryan::Lexer lexer;
+	Peryan::Parser parser;
+
+public:
+	BoundsCheckerTest() : ssr("main.pr"), wp(), lexer(ssr, opt, wp), parser(lexer, opt, wp) {}
+
+	// returns the last repeat statement
+	Peryan::RepeatStmt *check(std::string str) {
+		ssr.setString("main.pr", str);
+
+		try {
+			parser.parse();
+		} catch (Peryan::ParserError pe) {
+			std::cout<<pe.toString(lexer)<<std::endl;
+			throw pe;
+		} catch (Peryan::SemanticsError se) {
+			std::cout<<se.toString(lexer)<<std::endl;
+			throw se;
+		}
+
+		opt.boundsCheck = true;
+		Peryan::BoundsChecker checker(parser.getSymbolTable(), opt, wp);
+		checker.visit(parser.getTransUnit());
+
+		Peryan::Stmt *last = parser.getTransUnit()->stmts.back();
+		EXPECT_EQ(Peryan::AST::REPEAT_STMT, last->getASTType());
+		return static_cast<Peryan::RepeatStmt *>(last);
+	}
+
+	// the subscript assigned by the first statement in the loop
+	Peryan::SubscrExpr *getAssigned(Peryan::RepeatStmt *rs) {
+		Peryan::Stmt *first = rs->stmts.front();
+		EXPECT_EQ(Peryan::AST::ASSIGN_STMT, first->getASTType());
+
+		Peryan::Expr *lhs = static_cast<Peryan::AssignStmt *>(first)->lhs;
+		EXPECT_EQ(Peryan::AST::SUBSCR_EXPR, lhs->getASTType());
+		return static_cast<Peryan::SubscrExpr *>(lhs);
+	}
+};
+
+TEST_F(BoundsCheckerTest, LengthLoop) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"repeat foo.length\n"
+		"\tfoo[cnt] = cnt\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::UNCHECKED, getAssigned(rs)->rangeCheck);
+	ASSERT_TRUE(rs->rangeCheckedArrays.empty());
+}
+
+TEST_F(BoundsCheckerTest, LongLengthLoop) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"repeat foo.longLength\n"
+		"\tfoo[cnt] = 1\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::UNCHECKED, getAssigned(rs)->rangeCheck);
+}
+
+TEST_F(BoundsCheckerTest, HoistedCheck) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"var bar = [Int](10)\n"
+		"repeat 5\n"
+		"\tfoo[cnt] = bar[cnt] + foo[cnt]\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::LOOP_CHECKED, getAssigned(rs)->rangeCheck);
+	ASSERT_EQ(rs, getAssigned(rs)->rangeLoop);
+	ASSERT_EQ(2u, rs->rangeCheckedArrays.size());
+}
+
+TEST_F(BoundsCheckerTest, OtherSubscript) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"repeat foo.length\n"
+		"\tfoo[cnt + 1] = cnt\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::CHECKED, getAssigned(rs)->rangeCheck);
+}
+
+TEST_F(BoundsCheckerTest, ResizedInLoop) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"repeat foo.length\n"
+		"\tfoo[cnt] = cnt\n"
+		"\tfoo.remove 0\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::CHECKED, getAssigned(rs)->rangeCheck);
+}
+
+TEST_F(BoundsCheckerTest, FunctionCallInLoop) {
+	const std::string source =
+		"var foo = [Int](10)\n"
+		"func shrink() :: Void {\n"
+		"\tfoo.resize 1\n"
+		"}\n"
+		"repeat foo.length\n"
+		"\tfoo[cnt] = cnt\n"
+		"\tshrink\n"
+		"loop\n";
+
+	Peryan::RepeatStmt *rs = check(source);
+
+	ASSERT_EQ(Peryan::SubscrExpr::CHECKED, getAssigned(rs)->rangeCheck);
+}
+
+}
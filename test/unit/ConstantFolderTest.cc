@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+
+#include "../../src/WarningPrinter.h"
+#include "../../src/Options.h"
+#include "../../src/Lexer.h"
+#include "../../src/Parser.h"
+#include "../../src/StringSourceReader.h"
+#include "../../src/AST.h"
+#include "../../src/ASTPrinter.h"
+#include "../../src/ConstantFolder.h"
+
+namespace {
+
+class ConstantFolderTest : public ::testing::Test {
+protected:
+	Peryan::Options opt;
+	Peryan::StringSourceReader ssr;
+	Peryan::WarningPrinter wp;
+	Peryan::Lexer lexer;
+	Peryan::Parser parser;
+
+public:
+	ConstantFolderTest() : ssr("main.pr"), wp(), lexer(ssr, opt, wp), parser(lexer, opt, wp) {}
+
+	std::string foldAndPrint(std::string str) {
+		ssr.setString("main.pr", str);
+
+		try {
+			parser.parse();
+
+			Peryan::ConstantFolder folder(parser.getSymbolTable(), opt, wp);
+			folder.visit(parser.getTransUnit());
+
+			Peryan::ASTPrinter printer;
+
+			return printer.toString(parser.getTransUnit());
+		} catch (Peryan::ParserError pe) {
+			std::cout<<pe.toString(lexer)<<std::endl;
+			throw pe;
+		} catch (Peryan::SemanticsError se) {
+			std::cout<<se.toString(lexer)<<std::endl;
+			throw se;
+		}
+	}
+};
+
+TEST_F(ConstantFolderTest, Arithmetic) {
+	const std::string source =
+		"var foo = 114 - 5 - 1 * 4\n"
+		"var bar = -(7 / 2) + 7 % 2\n"
+		"var baz = 1.5 * 2.0\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"foo\") (IntLiteralExpr 105))"
+			" (VarDefStmt (Identifier \"bar\") (IntLiteralExpr -2))"
+			" (VarDefStmt (Identifier \"baz\") (FloatLiteralExpr 3)))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, DivisionByZero) {
+	const std::string source =
+		"var foo = 1 / 0\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"foo\")"
+				" (BinaryExpr <SLASH> (IntLiteralExpr 1) (IntLiteralExpr 0))))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, Logical) {
+	const std::string source =
+		"var foo = !(1 < 2) | (1.0 != 2.0)\n"
+		"var bar = \"a\" == \"b\"\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"foo\") (BoolLiteralExpr true))"
+			" (VarDefStmt (Identifier \"bar\") (BoolLiteralExpr false)))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, StringConstructors) {
+	const std::string source =
+		"var foo = \"Pery\" + \"an\" + String(114 + 514)\n"
+		"var bar = Int(\"-42\") + 1\n"
+		"var baz = Int(\"4x2\")\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"foo\") (StrLiteralExpr \"Peryan628\"))"
+			" (VarDefStmt (Identifier \"bar\") (IntLiteralExpr -41))"
+			" (VarDefStmt (Identifier \"baz\")"
+				" (ConstructorExpr (TypeSpec \"Int\") (StrLiteralExpr \"4x2\"))))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, Propagation) {
+	const std::string source =
+		"var length = 1000\n"
+		"var half = length / 2\n"
+		"var count = 0\n"
+		"count += half\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"length\") (IntLiteralExpr 1000))"
+			" (VarDefStmt (Identifier \"half\") (IntLiteralExpr 500))"
+			" (VarDefStmt (Identifier \"count\") (IntLiteralExpr 0))"
+			" (AssignStmt <PLUSEQ> (Identifier \"count\") (IntLiteralExpr 500)))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, ModifiedVariable) {
+	const std::string source =
+		"var foo = 1\n"
+		"foo = 2\n"
+		"var bar = foo + 1\n";
+
+	const std::string expected =
+		"(TransUnit"
+			" (VarDefStmt (Identifier \"foo\") (IntLiteralExpr 1))"
+			" (AssignStmt <EQL> (Identifier \"foo\") (IntLiteralExpr 2))"
+			" (VarDefStmt (Identifier \"bar\")"
+				" (BinaryExpr <PLUS> (DerefExpr (Identifier \"foo\")) (IntLiteralExpr 1))))";
+
+	ASSERT_EQ(expected, foldAndPrint(source));
+}
+
+TEST_F(ConstantFolderTest, ReferencedVariable) {
+	const std::string source =
+		"func inc(x :: ref Int) :: Void {\n"
+		"\tx += 1\n"
+		"}\n"
+		"var foo = 1\n"
+		"inc foo\n"
+		"var bar = foo\n";
+
+	const std::string folded = foldAndPrint(source);
+
+	ASSERT_EQ(std::string::npos, folded.find("(VarDefStmt (Identifier \"bar\") (IntLiteralExpr"));
+}
+
+TEST_F(ConstantFolderTest, ReadBeforeDefinition) {
+	const std::string source =
+		"var early = show()\n"
+		"var foo = 1\n"
+		"var bar = 2\n"
+		"func show() :: Int {\n"
+		"\treturn foo + twice()\n"
+		"}\n"
+		"func twice() :: Int {\n"
+		"\treturn bar * 2\n"
+		"}\n"
+		"var baz = 3\n"
+		"var late = show() + baz\n";
+
+	const std::string folded = foldAndPrint(source);
+
+	// show reads foo and bar (through twice) before they are defined, but baz only after that
+	ASSERT_NE(std::string::npos, folded.find("(DerefExpr (Identifier \"foo\"))"));
+	ASSERT_NE(std::string::npos, folded.find("(DerefExpr (Identifier \"bar\"))"));
+	ASSERT_NE(std::string::npos, folded.find("(FuncCallExpr (Identifier \"show\")) (IntLiteralExpr 3)"));
+}
+
+TEST_F(ConstantFolderTest, VariableWithLabels) {
+	const std::string source =
+		"goto *skip\n"
+		"var foo = 1\n"
+		"*skip\n"
+		"var bar = foo\n";
+
+	opt.hspCompat = true;
+	const std::string folded = foldAndPrint(source);
+
+	ASSERT_NE(std::string::npos, folded.find("(VarDefStmt (Identifier \"bar\") (DerefExpr (Identifier \"foo\")))"));
+}
+
+TEST_F(ConstantFolderTest, RepeatCounter) {
+	const std::string source =
+		"func inc(x :: ref Int) :: Void {\n"
+		"\tx += 1\n"
+		"}\n"
+		"var foo = 0\n"
+		"repeat 10\n"
+		"\tfoo += cnt\n"
+		"loop\n"
+		"repeat 10\n"
+		"\tcnt = cnt + 1\n"
+		"loop\n"
+		"repeat 10\n"
+		"\tinc cnt\n"
+		"loop\n";
+
+	foldAndPrint(source);
+
+	std::vector<Peryan::Stmt *>& stmts = parser.getTransUnit()->stmts;
+	ASSERT_EQ(Peryan::AST::REPEAT_STMT, stmts[stmts.size() - 3]->getASTType());
+	ASSERT_FALSE(static_cast<Peryan::RepeatStmt *>(stmts[stmts.size() - 3])->isCounterModified);
+	ASSERT_TRUE(static_cast<Peryan::RepeatStmt *>(stmts[stmts.size() - 2])->isCounterModified);
+	ASSERT_TRUE(static_cast<Peryan::RepeatStmt *>(stmts[stmts.size() - 1])->isCounterModified);
+}
+
+}
@@ -0,0 +1,164 @@
+#include "gtest/gtest.h"
+
+#include "../../src/WarningPrinter.h"
+#include "../../src/Options.h"
+#include "../../src/Lexer.h"
+#include "../../src/Parser.h"
+#include "../../src/StringSourceReader.h"
+#include "../../src/AST.h"
+#include "../../src/EscapeAnalyzer.h"
+
+namespace {
+
+class EscapeAnalyzerTest : public ::testing::Test {
+protected:
+	Peryan::Options opt;
+	Peryan::StringSourceReader ssr;
+	Peryan::WarningPrinter wp;
+	Peryan::Lexer lexer;
+	Peryan::Parser parser;
+
+public:
+	EscapeAnalyzerTest() : ssr("main.pr"), wp(), lexer(ssr, opt, wp), parser(lexer, opt, wp) {}
+
+	void analyze(std::string str) {
+		ssr.setString("main.pr", str);
+
+		try {
+			parser.parse();
+		} catch (Peryan::ParserError pe) {
+			std::cout<<pe.toString(lexer)<<std::endl;
+			throw pe;
+		} catch (Peryan::SemanticsError se) {
+			std::cout<<se.toString(lexer)<<std::endl;
+			throw se;
+		}
+
+		Peryan::EscapeAnalyzer analyzer(parser.getSymbolTable(), opt, wp);
+		analyzer.visit(parser.getTransUnit());
+		return;
+	}
+
+	bool isMainLocal(const std::string& name) {
+		Peryan::Scope *scope = parser.getTransUnit()->scope;
+		Peryan::Symbol *symbol = NULL;
+		for (Peryan::Scope::iterator it = scope->begin(); it != scope->end(); ++it) {
+			if ((*it)->getSymbolName() == name)
+				symbol = *it;
+		}
+		EXPECT_TRUE(symbol != NULL);
+		EXPECT_EQ(Peryan::Symbol::VAR_SYMBOL, symbol->getSymbolType());
+		return static_cast<Peryan::VarSymbol *>(symbol)->isMainLocal;
+	}
+
+	// the capacity of the array defined by the index-th statement of the function at func
+	int getStackCapacity(int func, int index) {
+		Peryan::Stmt *fds = parser.getTransUnit()->stmts[func];
+		EXPECT_EQ(Peryan::AST::FUNC_DEF_STMT, fds->getASTType());
+
+		Peryan::Stmt *def = static_cast<Peryan::FuncDefStmt *>(fds)->body->stmts[index];
+		EXPECT_EQ(Peryan::AST::VAR_DEF_STMT, def->getASTType());
+		return static_cast<Peryan::VarSymbol *>(static_cast<Peryan::VarDefStmt *>(def)->symbol)->stackCapacity;
+	}
+};
+
+TEST_F(EscapeAnalyzerTest, MainOnly) {
+	const std::string source =
+		"var foo = 1\n"
+		"var bar = [Int](10)\n"
+		"repeat 10\n"
+		"\tbar[cnt] = foo\n"
+		"loop\n";
+
+	analyze(source);
+
+	ASSERT_TRUE(isMainLocal("foo"));
+	ASSERT_TRUE(isMainLocal("bar"));
+}
+
+TEST_F(EscapeAnalyzerTest, ReferredFromFunction) {
+	const std::string source =
+		"var foo = 1\n"
+		"var bar = 2\n"
+		"func baz(x :: Int) :: Int {\n"
+		"\treturn x + foo\n"
+		"}\n"
+		"bar = baz(bar)\n";
+
+	analyze(source);
+
+	ASSERT_FALSE(isMainLocal("foo"));
+	ASSERT_TRUE(isMainLocal("bar"));
+}
+
+TEST_F(EscapeAnalyzerTest, Labels) {
+	const std::string source =
+		"var foo = 1\n"
+		"repeat 3\n"
+		"\tgosub *bar\n"
+		"loop\n"
+		"repeat 3\n"
+		"\tfoo += cnt\n"
+		"loop\n"
+		"return\n"
+		"*bar\n"
+		"foo = 2\n"
+		"return\n";
+
+	opt.hspCompat = true;
+	analyze(source);
+
+	ASSERT_TRUE(isMainLocal("foo"));
+
+	std::vector<Peryan::Stmt *>& stmts = parser.getTransUnit()->stmts;
+	ASSERT_EQ(Peryan::AST::REPEAT_STMT, stmts[stmts.size() - 6]->getASTType());
+	ASSERT_EQ(Peryan::AST::REPEAT_STMT, stmts[stmts.size() - 5]->getASTType());
+	ASSERT_TRUE(static_cast<Peryan::RepeatStmt *>(stmts[stmts.size() - 6])->hasGosub);
+	ASSERT_FALSE(static_cast<Peryan::RepeatStmt *>(stmts[stmts.size() - 5])->hasGosub);
+}
+
+TEST_F(EscapeAnalyzerTest, StackArrays) {
+	const std::string source =
+		"func foo(x :: Int) :: Int {\n"
+		"\tvar a = [Int](8)\n"
+		"\tvar b = [1, 2, 3]\n"
+		"\tvar c = [Int](x)\n"
+		"\tvar d = [Int](1000)\n"
+		"\ta[0] = b[1] + c[0] + d[0]\n"
+		"\treturn a[0]\n"
+		"}\n"
+		"var r = foo(1)\n";
+
+	analyze(source);
+
+	ASSERT_EQ(8, getStackCapacity(0, 0));
+	ASSERT_EQ(3, getStackCapacity(0, 1));
+	ASSERT_EQ(0, getStackCapacity(0, 2));
+	ASSERT_EQ(0, getStackCapacity(0, 3));
+}
+
+TEST_F(EscapeAnalyzerTest, EscapingArrays) {
+	const std::string source =
+		"func bar(x :: ref [Int]) :: Void {\n"
+		"}\n"
+		"func foo() :: Int {\n"
+		"\tvar a = [Int](8)\n"
+		"\tvar b = [Int](8)\n"
+		"\tvar c = [Int](8)\n"
+		"\tvar d = [Int](8)\n"
+		"\ta.push 1\n"
+		"\tb = d\n"
+		"\tbar c\n"
+		"\treturn d.length\n"
+		"}\n"
+		"var r = foo()\n";
+
+	analyze(source);
+
+	ASSERT_EQ(0, getStackCapacity(1, 0));
+	ASSERT_EQ(0, getStackCapacity(1, 1));
+	ASSERT_EQ(0, getStackCapacity(1, 2));
+	ASSERT_EQ(8, getStackCapacity(1, 3));
+}
+
+}
@@ -151,4 +151,41 @@ TEST_F(LexerTest, PrettyPrint) {
 
 }
 
+TEST_F(LexerTest, SourceLocation) {
+	ssr.setString("main.pr",
+		"foo\n"
+		"#import \"sub.pr\"\n"
+		"bar\n"
+		"\tbaz\n");
+
+	ssr.setString("sub.pr",
+		"alpha\n"
+		"beta\n");
+
+	std::vector<Peryan::Token> tokens;
+
+	while (true) {
+		Peryan::Token cur = lexer.getNextToken();
+		tokens.push_back(cur);
+		if (cur.getType() == Peryan::Token::END)
+			break;
+	}
+
+	// foo, alpha, beta, bar, baz with the line terminators between them
+	ASSERT_EQ("<ID, baz>", tokens[8].toString());
+
+	std::string name;
+	int line = 0, column = 0;
+
+	lexer.getSourceLocation(tokens[4].getPosition(), name, line, column);
+	ASSERT_EQ("sub.pr", name);
+	ASSERT_EQ(2, line);
+	ASSERT_EQ(1, column);
+
+	lexer.getSourceLocation(tokens[8].getPosition(), name, line, column);
+	ASSERT_EQ("main.pr", name);
+	ASSERT_EQ(4, line);
+	ASSERT_EQ(2, column);
+}
+
 }
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <limits>
+
 #include "../../src/WarningPrinter.h"
 #include "../../src/Options.h"
 #include "../../src/Lexer.h"
@@ -30,6 +32,26 @@ public:
 			throw se;
 		}
 	}
+
+	// the types of foo, hoge and hige after parsing the source with the given number of jobs
+	std::string inferTypes(const std::string& source, int jobs) {
+		Peryan::Options options;
+		options.jobs = jobs;
+		Peryan::StringSourceReader reader("main.pr");
+		Peryan::WarningPrinter printer;
+		Peryan::Lexer lex(reader, options, printer);
+		Peryan::Parser par(lex, options, printer);
+
+		reader.setString("main.pr", source);
+		par.parse();
+
+		// resolve them after all the definitions
+		const Peryan::Position end = std::numeric_limits<Peryan::Position>::max();
+		Peryan::GlobalScope *gs = par.getSymbolTable().getGlobalScope();
+		return gs->resolve("foo", end)->getType()->getTypeName()
+			+ ", " + gs->resolve("hoge", end)->getType()->getTypeName()
+			+ ", " + gs->resolve("hige", end)->getType()->getTypeName();
+	}
 };
 
 TEST_F(SemanticsTest, VariableDefinition1) {
@@ -226,5 +248,198 @@ TEST_F(SemanticsTest, TooMuchArgumentsForFuncCall) {
 
 }
 
+TEST_F(SemanticsTest, BinaryOperatorTypes) {
+	const std::string source =
+		"var foo = 1 + 2 * 3 % 4\n"
+		"var bar = 1.0 / 2.0 < 3.0\n"
+		"var baz = \"foo\" + \"bar\" == \"foobar\"\n"
+		"var qux :: Bool = foo << 2 > 3 & bar | baz\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_NO_THROW(parse());
+}
+
+TEST_F(SemanticsTest, DisallowedBinaryOperator) {
+	const std::string source =
+		"var foo = 1.0 % 2.0\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parse(), Peryan::SemanticsError);
+}
+
+TEST_F(SemanticsTest, ArrayMethods) {
+	const std::string source =
+		"var foo = [Int]()\n"
+		"foo.push 1\n"
+		"foo.insert 0, 2\n"
+		"foo.remove 1\n"
+		"var bar :: Int = foo.pop()\n"
+		"foo.reserve 10\n"
+		"foo.resize 3\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_NO_THROW(parse());
+}
+
+TEST_F(SemanticsTest, Int64Widening) {
+	const std::string source =
+		"var foo = 1\n"
+		"var bar :: Int64 = foo\n"
+		"var baz :: Int64 = bar * foo + 2\n"
+		"var arr = [Int](Int64(3))\n"
+		"arr[bar] = arr.length\n"
+		"var len :: Int64 = arr.longLength\n"
+		"repeat len\n"
+		"\tbaz = cnt\n"
+		"loop\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_NO_THROW(parse());
+}
+
+TEST_F(SemanticsTest, Int64Narrowing) {
+	const std::string source =
+		"var foo = Int64(1)\n"
+		"var bar :: Int = foo\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parse(), Peryan::SemanticsError);
+}
+
+TEST_F(SemanticsTest, Int64HspCompatLeftWins) {
+	const std::string source =
+		"func foo(a :: Int64, b :: Float) :: Int64 {\n"
+		"\treturn a + b\n"
+		"}\n"
+		"func bar(a :: Int64, b :: Float) :: Float {\n"
+		"\treturn b * a\n"
+		"}\n";
+
+	opt.hspCompat = true;
+	ssr.setString("main.pr", source);
+
+	ASSERT_NO_THROW(parse());
 }
 
+TEST_F(SemanticsTest, ConstantArrayMethod) {
+	const std::string source =
+		"func foo(arr :: const ref [Int]) :: Void {\n"
+		"\tarr.push 1\n"
+		"}\n";
+
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parser.parse(), Peryan::SemanticsError);
+}
+
+TEST_F(SemanticsTest, NestedLabel) {
+	const std::string source =
+		"repeat 10\n"
+		"\t*foo\n"
+		"loop\n";
+
+	opt.hspCompat = true;
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parser.parse(), Peryan::SemanticsError);
+}
+
+TEST_F(SemanticsTest, UnusedLibraryFunction) {
+	const std::string library =
+		"func unused() :: Int {\n"
+		"\treturn undefinedVariable\n"
+		"}\n";
+	const std::string source =
+		"#include \"library.pr\"\n"
+		"var foo = 1\n";
+
+	ssr.setString("library.pr", library);
+	ssr.setString("main.pr", source);
+
+	ASSERT_NO_THROW(parse());
+}
+
+TEST_F(SemanticsTest, ReferencedLibraryFunction) {
+	const std::string library =
+		"func used() :: Int {\n"
+		"\treturn helper()\n"
+		"}\n"
+		"func helper() :: Int {\n"
+		"\treturn undefinedVariable\n"
+		"}\n";
+	const std::string source =
+		"#include \"library.pr\"\n"
+		"var foo = used()\n";
+
+	ssr.setString("library.pr", library);
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parse(), Peryan::SemanticsError);
+}
+
+TEST_F(SemanticsTest, ParallelFunctionBodies) {
+	const std::string source =
+		"func foo(x) {\n"
+		"\tvar y = x + 1\n"
+		"\treturn y\n"
+		"}\n"
+		"func bar(s :: String) :: String {\n"
+		"\treturn s + \"bar\"\n"
+		"}\n"
+		"func baz() :: Int {\n"
+		"\treturn foo(1) * 2\n"
+		"}\n"
+		"var hoge = bar(\"foo\")\n"
+		"var hige = baz()\n";
+
+	// the types inferred by the workers are the same as the ones inferred sequentially
+	ASSERT_EQ(inferTypes(source, 1), inferTypes(source, 4));
+	ASSERT_EQ("Int -> Int, String, Int", inferTypes(source, 4));
+}
+
+TEST_F(SemanticsTest, ParallelDefaultArguments) {
+	// the default argument is shared by the call sites in the bodies checked on the workers
+	const std::string source =
+		"func add(a :: Int, b :: Int64 = 1 + 2) :: Int64 {\n"
+		"\treturn b\n"
+		"}\n"
+		"func foo(x) {\n"
+		"\treturn add(x)\n"
+		"}\n"
+		"func bar() {\n"
+		"\treturn add(2) * add(3)\n"
+		"}\n"
+		"func baz() :: Int64 {\n"
+		"\treturn add(4) + foo(5)\n"
+		"}\n"
+		"var hoge = bar()\n"
+		"var hige = baz()\n";
+
+	ASSERT_EQ(inferTypes(source, 1), inferTypes(source, 4));
+	ASSERT_EQ("Int -> Int64, Int64, Int64", inferTypes(source, 4));
+}
+
+TEST_F(SemanticsTest, ParallelFunctionBodiesError) {
+	const std::string source =
+		"func foo() :: Int {\n"
+		"\treturn 1\n"
+		"}\n"
+		"func bar() :: Int {\n"
+		"\treturn undefinedVariable\n"
+		"}\n"
+		"func baz() :: Int {\n"
+		"\treturn 3\n"
+		"}\n";
+
+	opt.jobs = 4;
+	ssr.setString("main.pr", source);
+
+	ASSERT_THROW(parse(), Peryan::SemanticsError);
+}
+
+}